@@ -1,51 +1,62 @@
 #include <iostream>
-#include <fstream>
+#include <memory_resource>
+#include <vector>
 
 #include "flexer.hpp"
+#include "flexer_io.hpp"
 
 int main(int argc, const char *argv[])
 {
-  if (argc != 2)
+  if (argc < 2)
   {
-    std::cout << "usage: " << argv[0] << " <file>\n";
+    std::cout << "usage: " << argv[0] << " <file>...\n";
     return 1;
   }
 
-  // read the file into `content`
-  const char *filename = argv[1];
-  std::ifstream file(filename);
-  if (!file.is_open())
-  {
-    std::cout << "error reading file: " << filename << "\n";
-    return 1;
-  }
-
-  std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-  file.close();
-
   flexer::config_t config;
   config.configure_as_c23();
-  
-  flexer::flexer flexer(config, content.c_str(), filename);
 
-  flexer::token_t t;
+  // files are read ahead while the previous one is lexed
+  flexer::batch_reader_t reader(std::vector<const char *>(argv + 1, argv + argc));
+  flexer::loaded_file_t file;
 
-  while (true)
-  {
-    flexer.get_token(t);
-    std::cout << t.to_string() << " at " << t.get_location().to_string() << "\n";
+  // all allocations made while lexing a file come from `arena` and are released at once
+  std::pmr::monotonic_buffer_resource arena;
 
-    if (t.get_kind() == flexer::token_kind_t::invalid)
+  while (reader.next(file))
+  {
+    if (!file.ok)
     {
-      std::cout << "*** invalid token detected ***\n";
+      std::cout << "error reading file: " << file.filename << "\n";
       return 1;
     }
 
-    if (t.get_kind() == flexer::token_kind_t::eof)
     {
-      break;
+      flexer::flexer flexer(config, file.content, file.size, flexer::padded_input, file.filename, &arena);
+
+      flexer::token_t t(&arena);
+
+      while (true)
+      {
+        flexer.get_token(t);
+        std::cout << t.to_string() << " at " << t.get_location().to_string() << "\n";
+
+        if (t.get_kind() == flexer::token_kind_t::invalid)
+        {
+          std::cout << "*** invalid token detected ***\n";
+          return 1;
+        }
+
+        if (t.get_kind() == flexer::token_kind_t::eof)
+        {
+          break;
+        }
+      }
     }
+
+    arena.release();
+    reader.release(file);
   }
 
   return 0;
-}
\ No newline at end of file
+}
@@ -4,16 +4,51 @@
 #include <cstdint>
 #include <cctype>
 #include <cstring>
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <array>
+#include <bitset>
+#include <deque>
+#include <map>
+#include <memory>
 #include <vector>
+#include <memory_resource>
 #include <format>
 #include <string>
 #include <string_view>
+#include <type_traits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// ssse3 code is compiled with a target attribute and picked at run time, so baseline x86-64 builds get it too
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <tmmintrin.h>
+#define FLEXER_HAS_SSSE3 1
+#endif
+
+#ifndef FLEXER_HAS_SSSE3
+#define FLEXER_HAS_SSSE3 0
+#endif
 
 namespace flexer
 {
 
 constexpr const char *default_filename = "<input>";
 
+// bytes readable past the end of a padded input, the first one being a zero sentinel; wide enough for any simd load
+constexpr std::size_t sentinel_padding = 64;
+
+// selects the padded-input constructor of `flexer`
+struct padded_input_t
+{
+  explicit padded_input_t() = default;
+};
+
+inline constexpr padded_input_t padded_input{};
+
 class location_t
 {
   public:
@@ -55,7 +90,146 @@ class location_t
   std::size_t _col;
 };
 
-enum class token_kind_t
+// a location encoded in 32 bits: an address in the global space handed out by `source_manager_t`.
+// zero is reserved for "no location", e.g. tokens of a flexer not attached to a source manager.
+class source_location_t
+{
+  public:
+
+  source_location_t() : _raw(0)
+  {
+    // nothing to do here!
+  }
+
+  explicit source_location_t(const std::uint32_t raw) : _raw(raw)
+  {
+    // nothing to do here!
+  }
+
+  std::uint32_t raw() const noexcept
+  {
+    return _raw;
+  }
+
+  bool is_valid() const noexcept
+  {
+    return _raw != 0;
+  }
+
+  auto operator<=>(const source_location_t &other) const = default;
+
+  private:
+
+  std::uint32_t _raw;
+};
+
+using file_id_t = std::uint32_t;
+
+// registers input buffers and maps each of them to a contiguous range of a single 32-bit address space.
+// every buffer gets one extra address past its end, for the location of eof.
+// buffers and filenames are not copied and must outlive the manager.
+class source_manager_t
+{
+  public:
+
+  explicit source_manager_t(std::pmr::memory_resource *resource = std::pmr::get_default_resource()) : _buffers(resource), _line_starts(resource)
+  {
+    // nothing to do here!
+  }
+
+  [[nodiscard]]
+  bool add_buffer(const char *filename, const char *content, const std::size_t size, file_id_t &file)
+  {
+    const std::uint32_t base = _buffers.empty() ? 1 : _buffers.back().base + _buffers.back().size + 1;
+
+    if (size >= std::numeric_limits<std::uint32_t>::max() - base)
+    {
+      return false;
+    }
+
+    file = static_cast<file_id_t>(_buffers.size());
+    _buffers.push_back({ filename, content, base, static_cast<std::uint32_t>(size), static_cast<std::uint32_t>(_line_starts.size()) });
+
+    _line_starts.push_back(base);
+    for (const char *p = content; (p = static_cast<const char *>(std::memchr(p, '\n', static_cast<std::size_t>(content + size - p)))) != nullptr; p++)
+    {
+      _line_starts.push_back(base + static_cast<std::uint32_t>(p - content) + 1);
+    }
+
+    return true;
+  }
+
+  [[nodiscard]]
+  bool add_buffer(const char *filename, const char *content, file_id_t &file)
+  {
+    return add_buffer(filename, content, std::strlen(content), file);
+  }
+
+  std::size_t get_file_count() const noexcept
+  {
+    return _buffers.size();
+  }
+
+  const char *get_filename(const file_id_t file) const
+  {
+    return _buffers[file].filename;
+  }
+
+  const char *get_content(const file_id_t file) const
+  {
+    return _buffers[file].content;
+  }
+
+  std::size_t get_size(const file_id_t file) const
+  {
+    return _buffers[file].size;
+  }
+
+  source_location_t get_source_location(const file_id_t file, const std::size_t offset) const
+  {
+    return source_location_t(_buffers[file].base + static_cast<std::uint32_t>(offset));
+  }
+
+  file_id_t get_file_id(const source_location_t location) const
+  {
+    const auto it = std::upper_bound(_buffers.begin(), _buffers.end(), location.raw(), [](const std::uint32_t raw, const source_buffer_t &buffer) { return raw < buffer.base; });
+    return static_cast<file_id_t>(it - _buffers.begin() - 1);
+  }
+
+  std::size_t get_offset(const source_location_t location) const
+  {
+    return location.raw() - _buffers[get_file_id(location)].base;
+  }
+
+  // location must be valid and come from this manager
+  location_t decode(const source_location_t location) const
+  {
+    const file_id_t file = get_file_id(location);
+    const source_buffer_t &buffer = _buffers[file];
+
+    const auto first = _line_starts.begin() + buffer.first_line;
+    const auto last = file + 1 < _buffers.size() ? _line_starts.begin() + _buffers[file + 1].first_line : _line_starts.end();
+    const auto line = std::upper_bound(first, last, location.raw()) - 1;
+
+    return location_t(buffer.filename, static_cast<std::size_t>(line - first) + 1, location.raw() - *line + 1);
+  }
+
+  private:
+
+  struct source_buffer_t
+  {
+    const char *filename;
+    const char *content;
+    std::uint32_t base;
+    std::uint32_t size;
+    std::uint32_t first_line; // index of the first entry of this buffer in `_line_starts`
+  };
+
+  std::pmr::vector<source_buffer_t> _buffers;
+  std::pmr::vector<std::uint32_t> _line_starts; // addresses of the beginning of every line of every buffer, in increasing order
+};
+
+enum class token_kind_t : std::uint8_t
 {
   invalid,
   eof,
@@ -64,17 +238,90 @@ enum class token_kind_t
   keyword,
   punctuation,
   string,
+  rule,
+};
+
+constexpr std::size_t token_kind_count = static_cast<std::size_t>(token_kind_t::rule) + 1;
+
+// why a token is invalid
+enum class diagnostic_t : std::uint8_t
+{
+  none,
+  unexpected_character,
+  unterminated_comment,
+  unterminated_string,
 };
 
 class token_t
 {
   public:
 
-  token_t() : _kind(token_kind_t::invalid), _location(), _begin(nullptr), _end(nullptr), _index(0), _value_integer(0)
+  using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+  token_t() : token_t(allocator_type{})
+  {
+    // nothing to do here!
+  }
+
+  explicit token_t(const allocator_type &allocator) : _kind(token_kind_t::invalid), _diagnostic(diagnostic_t::none), _encoded(false), _index(0), _location{ 0, 0, default_filename }, _begin(nullptr), _end(nullptr), _value_integer(0), _value_string(allocator)
   {
     // nothing to do here!
   }
 
+  token_t(const token_t &other) = default;
+  token_t(token_t &&other) = default;
+
+  token_t(const token_t &other, const allocator_type &allocator) :
+    _kind(other._kind),
+    _diagnostic(other._diagnostic),
+    _encoded(other._encoded),
+    _index(other._index),
+    _location(other._location),
+    _begin(other._begin),
+    _end(other._end),
+    _value_integer(other._value_integer),
+    _value_string(other._value_string, allocator)
+  {
+    // nothing to do here!
+  }
+
+  token_t(token_t &&other, const allocator_type &allocator) :
+    _kind(other._kind),
+    _diagnostic(other._diagnostic),
+    _encoded(other._encoded),
+    _index(other._index),
+    _location(other._location),
+    _begin(other._begin),
+    _end(other._end),
+    _value_integer(other._value_integer),
+    _value_string(std::move(other._value_string), allocator)
+  {
+    // nothing to do here!
+  }
+
+  token_t &operator=(const token_t &other) = default;
+  token_t &operator=(token_t &&other) = default;
+
+  allocator_type get_allocator() const noexcept
+  {
+    return _value_string.get_allocator();
+  }
+
+  // resets the token to its default state, but keeps the capacity of the string payload so that
+  // a token reused across `get_token` calls stops allocating once it is warmed up.
+  void reset() noexcept
+  {
+    _kind = token_kind_t::invalid;
+    _diagnostic = diagnostic_t::none;
+    _encoded = false;
+    _index = 0;
+    _location = { 0, 0, default_filename };
+    _begin = nullptr;
+    _end = nullptr;
+    _value_integer = 0;
+    _value_string.clear();
+  }
+
   void set_kind(const token_kind_t kind)
   {
     _kind = kind;
@@ -87,12 +334,38 @@ class token_t
 
   void set_location(const location_t &location) noexcept
   {
-    _location = location;
+    _encoded = false;
+    _location = { static_cast<std::uint32_t>(location.row()), static_cast<std::uint32_t>(location.col()), location.filename() };
   }
 
+  // a default location for tokens of a flexer attached to a source manager, which only keep their source location;
+  // decode it with `get_location(sources)` or `sources.decode(get_source_location())`
   location_t get_location() const noexcept
   {
-    return _location;
+    if (_encoded)
+    {
+      return location_t{};
+    }
+
+    return location_t(_location.filename, _location.row, _location.col);
+  }
+
+  // the location of the token whichever flexer lexed it, decoding its source location through `sources` if it has one
+  location_t get_location(const source_manager_t &sources) const noexcept
+  {
+    return _encoded ? sources.decode(_source_location) : get_location();
+  }
+
+  void set_source_location(const source_location_t source_location) noexcept
+  {
+    _encoded = true;
+    _source_location = source_location;
+  }
+
+  // invalid unless the token was lexed by a flexer attached to a source manager
+  source_location_t get_source_location() const noexcept
+  {
+    return _encoded ? _source_location : source_location_t{};
   }
 
   void set_begin(const char *begin) noexcept
@@ -117,7 +390,7 @@ class token_t
 
   void set_index(const std::size_t index) noexcept
   {
-    _index = index;
+    _index = static_cast<std::uint32_t>(index);
   }
 
   std::size_t get_index() const noexcept
@@ -125,12 +398,22 @@ class token_t
     return _index;
   }
 
+  void set_diagnostic(const diagnostic_t diagnostic) noexcept
+  {
+    _diagnostic = diagnostic;
+  }
+
+  diagnostic_t get_diagnostic() const noexcept
+  {
+    return _diagnostic;
+  }
+
   std::ptrdiff_t &value_integer() noexcept
   {
     return _value_integer;
   }
 
-  std::string &value_string() noexcept
+  std::pmr::string &value_string() noexcept
   {
     return _value_string;
   }
@@ -179,6 +462,11 @@ class token_t
         return std::format("string({}) `{}` -> `{}`", _index, std::string_view{ _begin, static_cast<std::size_t>(_end - _begin) }, _value_string);
       }
 
+      case token_kind_t::rule:
+      {
+        return std::format("rule({}) `{}`", _index, std::string_view{ _begin, static_cast<std::size_t>(_end - _begin) });
+      }
+
       default:
       {
         return "<unknown token>";
@@ -189,547 +477,3411 @@ class token_t
   private:
 
   token_kind_t _kind;
-  location_t _location;
-  const char *_begin;
-  const char *_end;
-  std::size_t _index;
-
-  std::ptrdiff_t _value_integer;
-  std::string _value_string;
-};
+  diagnostic_t _diagnostic; // why the token is invalid, `none` for valid tokens
+  bool _encoded; // whether the token has a source location rather than a location
+  std::uint32_t _index;
 
-struct state_t // TODO: convert to class with proper encapsulation
-{
-  state_t() : cur(0), bol(0), row(0)
+  // the location, 32 bits per coordinate like source locations
+  struct plain_location_t
   {
-    // nothing to do here!
-  }
+    std::uint32_t row;
+    std::uint32_t col;
+    const char *filename;
+  };
+
+  // a token of a flexer attached to a source manager keeps only its 32-bit source location, nothing that points
+  // back to the manager
+  union
+  {
+    plain_location_t _location;
+    source_location_t _source_location;
+  };
 
-  std::size_t cur;
-  std::size_t bol;
-  std::size_t row;
-};
+  const char *_begin;
+  const char *_end;
 
-struct comment_delimiter_t
-{
-  const char *opening;
-  const char *closing;
-  bool accept_eof_as_closing;
+  std::ptrdiff_t _value_integer;
+  std::pmr::string _value_string;
 };
 
-struct string_delimiter_t
-{
-  const char *opening;
-  const char *closing;
-};
+using token_list_t = std::pmr::vector<token_t>;
 
-struct string_escape_sequence_t
+// statistics gathered by `count_policy_t`
+struct scan_stats_t
 {
-  const char *escaped;
-  const char *unescaped;
-};
+  std::array<std::size_t, token_kind_count> counts{}; // number of tokens of each kind, indexed by `token_kind_t`
+  std::size_t comments = 0;
 
-struct config_t
-{
-  public:
+  std::size_t lines = 0;
+  std::size_t code_lines = 0; // lines with at least a part of a token
+  std::size_t comment_lines = 0; // lines with at least a part of a comment
+  std::size_t blank_lines = 0; // lines with nothing but whitespace
 
-  config_t() = default;
-  
-  void configure_as_ansi_c()
+  std::size_t count(const token_kind_t kind) const noexcept
   {
-    _symbol_starts = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_";
-    _symbol_continuations = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_0123456789";
-
-    _keywords.insert(_keywords.end(), { "auto", "break", "case", "char", "const", "continue", "default", "do", "double", "else", "enum", "extern", "float", "for", "goto", "if", "int", "long", "register", "return", "short", "signed", "sizeof", "static", "struct", "switch", "typedef", "union", "unsigned", "void", "volatile", "while" });
-    _punctuations.insert(_punctuations.end(), { "(", ")", "[", "]", "{", "}", "...", "*=", "/=", "%=", "+=", "-=", "<<=", ">>=", "&=", "^=", "|=", "->", "++", "--", "&", "*", "+", "-", "~", "!", "/", "%", "<<", ">>", "<=", ">=", "<", ">", "==", "!=", "^", "|", "&&", "||", "?", ":", ";", ".", "=", "," });
-    
-    _string_delimiters.insert(_string_delimiters.end(), { { "\"", "\"" }, { "\'", "\'" } });
-    _string_escape_sequences.insert(_string_escape_sequences.end(), { { "\\\"", "\"" }, { "\\\'", "\'" }, { "\\\\", "\\" }, { "\\a", "\a" }, { "\\b", "\b" }, { "\\f", "\f" }, { "\\n", "\n" }, { "\\r", "\r" }, { "\\t", "\t" }, { "\\v", "\v" } });
-    
-    _comment_delimiters.insert(_comment_delimiters.end(), { { "/*", "*/", false }, { "//", "\n", true } });
+    return counts[static_cast<std::size_t>(kind)];
   }
+};
 
-  void configure_as_c99()
-  {
-    configure_as_ansi_c();
-    _keywords.insert(_keywords.end(), { "inline", "restrict", "_Bool", "_Complex", "_Imaginary" });
-  }
+// policies for `flexer::scan`. a policy provides `track_lines` and `on_token(kind, index, begin, end)`; if `track_lines` is set
+// it also receives `on_comment()`, `on_newline()`, `on_continuation(comment)` when a comment or a token goes on
+// past a newline, and `on_end(last_line_not_empty)`.
 
-  void configure_as_c11()
-  {
-    configure_as_c99();
-    _keywords.insert(_keywords.end(), { "_Alignas", "_Alignof", "_Atomic", "_Generic", "_Noreturn", "_Static_assert", "_Thread_local" });
-  }
+// per-kind token counts and line statistics
+class count_policy_t
+{
+  public:
 
-  void configure_as_c23()
-  {
-    configure_as_c11();
-    _keywords.insert(_keywords.end(), { "alignas", "alignof", "bool", "constexpr", "false", "nullptr", "static_assert", "thread_local", "true", "typeof", "typeof_unqual", "_BitInt", "_Decimal128", "_Decimal32", "_Decimal64" });
-  }
+  static constexpr bool track_lines = true;
 
-  const char *get_symbol_starts() const
+  void on_token(const token_kind_t kind, const std::size_t, const char *, const char *)
   {
-    return _symbol_starts;
-  }
+    _stats.counts[static_cast<std::size_t>(kind)]++;
 
-  void set_symbol_starts(const char *symbol_starts)
-  {
-    _symbol_starts = symbol_starts;
+    if (kind != token_kind_t::eof)
+    {
+      _code = true;
+    }
   }
 
-  const char *get_symbol_continuations() const
+  void on_comment()
   {
-    return _symbol_continuations;
+    _stats.comments++;
+    _comment = true;
   }
 
-  void set_symbol_continuations(const char *symbol_continuations)
+  void on_continuation(const bool comment)
   {
-    _symbol_continuations = symbol_continuations;
+    (comment ? _comment : _code) = true;
   }
 
-  const std::vector<const char *> &get_punctuations() const
+  void on_newline()
   {
-    return _punctuations;
-  }
+    _stats.lines++;
+    _stats.code_lines += _code ? 1 : 0;
+    _stats.comment_lines += _comment ? 1 : 0;
+    _stats.blank_lines += !_code && !_comment ? 1 : 0;
 
-  void set_punctuations(std::vector<const char *> &punctuations)
-  {
-    _punctuations = punctuations;
+    _code = false;
+    _comment = false;
   }
 
-  const std::vector<const char *> &get_keywords() const
+  void on_end(const bool last_line_not_empty)
   {
-    return _keywords;
+    if (last_line_not_empty)
+    {
+      on_newline();
+    }
   }
 
-  void set_keywords(std::vector<const char *> &keywords)
+  const scan_stats_t &get_stats() const noexcept
   {
-    _keywords = keywords;
+    return _stats;
   }
 
-  const std::vector<string_delimiter_t> &get_string_delimiters() const
-  {
-    return _string_delimiters;
-  }
+  private:
 
-  void set_string_delimiters(std::vector<string_delimiter_t> &strings)
-  {
-    _string_delimiters = strings;
-  }
+  scan_stats_t _stats;
+  bool _code = false;
+  bool _comment = false;
+};
 
-  const std::vector<string_escape_sequence_t> &get_string_escape_sequences() const
-  {
-    return _string_escape_sequences;
-  }
+// the stream of token kinds, eof included
+class kind_policy_t
+{
+  public:
 
-  void set_string_escape_sequences(std::vector<string_escape_sequence_t> &string_escape_sequences)
-  {
-    _string_escape_sequences = string_escape_sequences;
-  }
+  static constexpr bool track_lines = false;
 
-  const std::vector<comment_delimiter_t> &get_comment_delimiters() const
+  explicit kind_policy_t(std::pmr::vector<token_kind_t> &kinds) : _kinds(kinds)
   {
-    return _comment_delimiters;
+    // nothing to do here!
   }
 
-  void set_comment_delimiters(std::vector<comment_delimiter_t> &comment_delimiters)
+  void on_token(const token_kind_t kind, const std::size_t, const char *, const char *)
   {
-    _comment_delimiters = comment_delimiters;
+    _kinds.push_back(kind);
   }
 
   private:
 
-  std::vector<const char *> _keywords; // if one of the keywords is a prefix of another one, the longer one should come first.
-  std::vector<const char *> _punctuations; // if one of the punctuations is a prefix of another one, the longer one should come first.
+  std::pmr::vector<token_kind_t> &_kinds;
+};
 
-  const char *_symbol_starts;
-  const char *_symbol_continuations;
+struct fingerprint_options_t
+{
+  std::size_t window = 5; // tokens per hashed window (k-gram)
+  std::size_t winnow = 4; // consecutive windows among which one fingerprint is selected
+  bool normalize_symbols = true; // symbols hash by kind only, so renamed identifiers still match
+  bool normalize_literals = true; // integers, strings and rule tokens hash by kind and index only
+};
 
-  std::vector<string_delimiter_t> _string_delimiters;
-  std::vector<string_escape_sequence_t> _string_escape_sequences;
-  std::vector<comment_delimiter_t> _comment_delimiters;
+struct fingerprint_t
+{
+  std::uint64_t hash;
+  std::size_t offset; // offset of the first token of the window
 };
 
-class flexer
+// winnowed rolling hashes over the token stream, for clone detection. every window of `window` tokens is hashed
+// with a polynomial rolling hash, and among every `winnow` consecutive windows the one with the smallest hash
+// (the rightmost one on ties) is selected, each selected window being reported once. comments and whitespace
+// do not take part, and eof is not hashed.
+class fingerprint_policy_t
 {
   public:
 
-  flexer(const config_t &config, const char *content, const char *filename = default_filename) : 
+  static constexpr bool track_lines = false;
+
+  fingerprint_policy_t(const char *content, const fingerprint_options_t &options, std::pmr::vector<fingerprint_t> &fingerprints) :
     _content(content),
-    _size(std::strlen(content)),
-    _filename(filename), 
-    _symbol_starts(config.get_symbol_starts()),
-    _symbol_continuations(config.get_symbol_continuations()),
-    _punctuations(config.get_punctuations()),
-    _keywords(config.get_keywords()),
-    _string_delimiters(config.get_string_delimiters()),
-    _string_escape_sequences(config.get_string_escape_sequences()),
-    _comment_delimiters(config.get_comment_delimiters())
+    _options(options),
+    _fingerprints(fingerprints),
+    _tokens(_options.window < 1 ? 1 : _options.window, fingerprints.get_allocator()),
+    _candidates(fingerprints.get_allocator())
   {
-    // nothing to do here!
+    _options.window = _tokens.size();
+    _options.winnow = _options.winnow < 1 ? 1 : _options.winnow;
+
+    _power = 1;
+    for (std::size_t i = 0; i < _options.window; i++)
+    {
+      _power *= base;
+    }
+  }
+
+  void on_token(const token_kind_t kind, const std::size_t index, const char *begin, const char *end)
+  {
+    if (kind == token_kind_t::eof)
+    {
+      // fewer windows than `winnow`: keep the best one anyway
+      if (_windows > 0 && _windows < _options.winnow)
+      {
+        select();
+      }
+
+      return;
+    }
+
+    const std::uint64_t h = hash_token(kind, index, begin, end);
+    hashed_token_t &slot = _tokens[_count % _options.window];
+
+    _hash = _hash * base + h - (_count >= _options.window ? slot.hash * _power : 0);
+    slot = { h, static_cast<std::size_t>(begin - _content) };
+    _count++;
+
+    if (_count < _options.window)
+    {
+      return;
+    }
+
+    // the window ends here, its first token is the oldest in the ring
+    const std::size_t window = _windows++;
+    const std::size_t offset = _tokens[_count % _options.window].offset;
+
+    while (!_candidates.empty() && _candidates.back().hash >= _hash)
+    {
+      _candidates.pop_back();
+    }
+
+    _candidates.push_back({ _hash, offset, window });
+
+    while (_candidates.front().window + _options.winnow <= window)
+    {
+      _candidates.pop_front();
+    }
+
+    if (_windows >= _options.winnow)
+    {
+      select();
+    }
+  }
+
+  private:
+
+  static constexpr std::uint64_t base = 0x100000001b3ull;
+
+  struct hashed_token_t
+  {
+    std::uint64_t hash;
+    std::size_t offset;
+  };
+
+  struct candidate_t
+  {
+    std::uint64_t hash;
+    std::size_t offset;
+    std::size_t window;
+  };
+
+  static std::uint64_t mix(std::uint64_t x)
+  {
+    // splitmix64 finalizer
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+
+    return x;
+  }
+
+  std::uint64_t hash_token(const token_kind_t kind, const std::size_t index, const char *begin, const char *end) const
+  {
+    std::uint64_t h = mix((static_cast<std::uint64_t>(kind) << 32) ^ index);
+
+    const bool literal = kind == token_kind_t::integer || kind == token_kind_t::string || kind == token_kind_t::rule || kind == token_kind_t::invalid;
+    if ((kind == token_kind_t::symbol && !_options.normalize_symbols) || (literal && !_options.normalize_literals))
+    {
+      // fnv-1a
+      for (const char *p = begin; p < end; p++)
+      {
+        h ^= static_cast<unsigned char>(*p);
+        h *= 0x100000001b3ull;
+      }
+
+      h = mix(h);
+    }
+
+    return h;
+  }
+
+  void select()
+  {
+    const candidate_t &best = _candidates.front();
+
+    if (!_selected || best.window != _last_window)
+    {
+      _fingerprints.push_back({ best.hash, best.offset });
+      _selected = true;
+      _last_window = best.window;
+    }
+  }
+
+  const char *_content;
+  fingerprint_options_t _options;
+  std::pmr::vector<fingerprint_t> &_fingerprints;
+
+  std::pmr::vector<hashed_token_t> _tokens; // ring of the last `window` tokens
+  std::size_t _count = 0;
+  std::uint64_t _hash = 0;
+  std::uint64_t _power = 1; // base to the power of `window`, to drop the oldest token
+
+  std::pmr::deque<candidate_t> _candidates; // windows of the current winnowing range, by increasing hash
+  std::size_t _windows = 0;
+  bool _selected = false;
+  std::size_t _last_window = 0;
+};
+
+// for every token of a token list, the index of the matching bracket token, filled by `flexer::tokenize`
+class bracket_index_t
+{
+  public:
+
+  static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+  explicit bracket_index_t(std::pmr::memory_resource *resource = std::pmr::get_default_resource()) : _partners(resource), _stack(resource), _unbalanced(resource)
+  {
+    // nothing to do here!
+  }
+
+  void clear()
+  {
+    _partners.clear();
+    _stack.clear();
+    _unbalanced.clear();
+  }
+
+  // the matching opener or closer of token `token`; `npos` if it is not a bracket or is unbalanced
+  std::size_t get_partner(const std::size_t token) const noexcept
+  {
+    return token < _partners.size() ? _partners[token] : npos;
+  }
+
+  // tokens of unbalanced brackets, in order
+  const std::pmr::vector<std::size_t> &get_unbalanced() const noexcept
+  {
+    return _unbalanced;
+  }
+
+  bool is_balanced() const noexcept
+  {
+    return _unbalanced.empty() && _stack.empty();
+  }
+
+  void add_opening(const std::size_t token, const std::size_t pair)
+  {
+    grow(token);
+    _stack.push_back({ token, pair });
+  }
+
+  // a closer matches the innermost open bracket of its pair; brackets opened after that one are unbalanced.
+  // if no bracket of its pair is open, the closer itself is unbalanced.
+  void add_closing(const std::size_t token, const std::size_t pair)
+  {
+    grow(token);
+
+    std::size_t depth = _stack.size();
+    while (depth > 0 && _stack[depth - 1].pair != pair)
+    {
+      depth--;
+    }
+
+    if (depth == 0)
+    {
+      _unbalanced.push_back(token);
+      return;
+    }
+
+    for (std::size_t i = depth; i < _stack.size(); i++)
+    {
+      _unbalanced.push_back(_stack[i].token);
+    }
+
+    _partners[_stack[depth - 1].token] = token;
+    _partners[token] = _stack[depth - 1].token;
+
+    _stack.resize(depth - 1);
+  }
+
+  // brackets still open are unbalanced
+  void finish()
+  {
+    for (const open_bracket_t &open : _stack)
+    {
+      _unbalanced.push_back(open.token);
+    }
+
+    _stack.clear();
+    std::sort(_unbalanced.begin(), _unbalanced.end());
+  }
+
+  private:
+
+  struct open_bracket_t
+  {
+    std::size_t token;
+    std::size_t pair;
+  };
+
+  void grow(const std::size_t token)
+  {
+    if (_partners.size() <= token)
+    {
+      _partners.resize(token + 1, npos);
+    }
+  }
+
+  std::pmr::vector<std::size_t> _partners;
+  std::pmr::vector<open_bracket_t> _stack;
+  std::pmr::vector<std::size_t> _unbalanced;
+};
+
+struct state_t // TODO: convert to class with proper encapsulation
+{
+  state_t() : cur(0), bol(0), row(0)
+  {
+    // nothing to do here!
+  }
+
+  std::size_t cur;
+  std::size_t bol;
+  std::size_t row;
+};
+
+// resumable lexer states recorded at token boundaries, about every `interval` bytes of input, where the lexer
+// is never inside a comment or a string. built lazily by `flexer::lex_range`, or at once by `flexer::build_checkpoints`;
+// an index belongs to the input it was built for.
+class checkpoint_index_t
+{
+  public:
+
+  explicit checkpoint_index_t(const std::size_t interval = 64 * 1024, std::pmr::memory_resource *resource = std::pmr::get_default_resource()) :
+    _interval(interval < 1 ? 1 : interval),
+    _checkpoints(1, state_t{}, resource),
+    _resume(),
+    _complete(false)
+  {
+    // nothing to do here!
+  }
+
+  std::size_t get_interval() const noexcept
+  {
+    return _interval;
+  }
+
+  const std::pmr::vector<state_t> &get_checkpoints() const noexcept
+  {
+    return _checkpoints;
+  }
+
+  // whether the whole input has been indexed
+  bool is_complete() const noexcept
+  {
+    return _complete;
+  }
+
+  // offset up to which the input has been indexed
+  std::size_t get_covered() const noexcept
+  {
+    return _resume.cur;
+  }
+
+  // the last checkpoint at or before `offset`, among those recorded so far
+  state_t find(const std::size_t offset) const
+  {
+    const auto it = std::upper_bound(_checkpoints.begin(), _checkpoints.end(), offset, [](const std::size_t o, const state_t &state) { return o < state.cur; });
+    return *(it - 1);
   }
 
+  private:
+
+  friend class flexer;
+
+  std::size_t _interval;
+  std::pmr::vector<state_t> _checkpoints;
+  state_t _resume; // where indexing stopped
+  bool _complete;
+};
+
+struct comment_delimiter_t
+{
+  const char *opening;
+  const char *closing;
+  bool accept_eof_as_closing;
+};
+
+struct string_delimiter_t
+{
+  const char *opening;
+  const char *closing;
+};
+
+struct string_escape_sequence_t
+{
+  const char *escaped;
+  const char *unescaped;
+};
+
+// a pair of punctuations, by index, that open and close a balanced region
+struct bracket_pair_t
+{
+  std::size_t opening;
+  std::size_t closing;
+};
+
+// what `get_token` and `scan` skip after invalid input, reporting it as a single invalid token
+enum class recovery_t
+{
+  none, // one byte after an unexpected character; the rest of the input after an unterminated comment or string
+  skip_run, // the whole run of bytes that no token, comment or whitespace can start with
+  skip_line, // up to the end of the line
+  skip_to_sync, // up to the next byte of the sync set of the config
+};
+
+struct token_rule_t
+{
+  const char *pattern; // regular expression, see `rule_dfa_t`
+  int priority; // breaks ties between matches of the same length; built-in token classes have priority 0
+};
+
+// all token rules of a config, compiled into a single minimized table-driven dfa.
+// supported syntax: literals, `.` (any byte but newline), `[...]` and `[^...]` with ranges, `\d`, `\w`, `\s`,
+// escapes (`\n`, `\t`, `\r`, `\0`, or any other escaped byte taken literally), grouping, `|`, `*`, `+` and `?`.
+class rule_dfa_t
+{
+  public:
+
+  static constexpr std::int32_t dead = -1;
+  static constexpr std::int32_t no_rule = -1;
+
+  rule_dfa_t() = default;
+
   [[nodiscard]]
-  bool get_current_char(char &c)
+  static bool compile(const std::vector<token_rule_t> &rules, rule_dfa_t &dfa)
   {
-    if (_state.cur >= _size)
+    nfa_t nfa;
+    const std::size_t start = nfa.add_state();
+
+    for (std::size_t i = 0; i < rules.size(); i++)
     {
-      return false;
+      const char *p = rules[i].pattern;
+      fragment_t fragment;
+
+      if (!parse_alternation(nfa, p, fragment) || *p != '\0')
+      {
+        return false;
+      }
+
+      nfa.states[start].epsilon.push_back(fragment.start);
+      nfa.states[fragment.end].rule = static_cast<std::int32_t>(i);
     }
 
-    c = _content[_state.cur];
+    rule_dfa_t result;
+    for (const token_rule_t &rule : rules)
+    {
+      result._priorities.push_back(rule.priority);
+    }
+
+    result.build_from(nfa, start);
+    result.minimize();
+
+    dfa = std::move(result);
     return true;
   }
 
+  // takes tables previously obtained from `get_transitions` and `get_accepts` of a compiled dfa
   [[nodiscard]]
-  bool get_next_char(char &c)
+  static bool assign(std::vector<std::int32_t> transitions, std::vector<std::int32_t> accepts, std::vector<int> priorities, rule_dfa_t &dfa)
   {
-    if (_state.cur + 1 >= _size)
+    if (transitions.size() != accepts.size() * 256)
     {
       return false;
     }
 
-    c = _content[_state.cur + 1];
+    for (const std::int32_t t : transitions)
+    {
+      if (t != dead && (t < 0 || static_cast<std::size_t>(t) >= accepts.size()))
+      {
+        return false;
+      }
+    }
+
+    for (const std::int32_t a : accepts)
+    {
+      if (a != no_rule && (a < 0 || static_cast<std::size_t>(a) >= priorities.size()))
+      {
+        return false;
+      }
+    }
+
+    dfa._transitions = std::move(transitions);
+    dfa._accepts = std::move(accepts);
+    dfa._priorities = std::move(priorities);
+
     return true;
   }
 
-  bool chop_character()
+  std::size_t get_state_count() const noexcept
   {
-    if (_state.cur < _size)
+    return _accepts.size();
+  }
+
+  const std::vector<std::int32_t> &get_transitions() const noexcept
+  {
+    return _transitions;
+  }
+
+  const std::vector<std::int32_t> &get_accepts() const noexcept
+  {
+    return _accepts;
+  }
+
+  std::int32_t next(const std::int32_t state, const unsigned char c) const noexcept
+  {
+    return _transitions[static_cast<std::size_t>(state) * 256 + c];
+  }
+
+  std::int32_t accept(const std::int32_t state) const noexcept
+  {
+    return _accepts[static_cast<std::size_t>(state)];
+  }
+
+  int priority(const std::size_t rule) const noexcept
+  {
+    return _priorities[rule];
+  }
+
+  // longest non-empty match of any rule at the beginning of [begin, end); returns its length, 0 if none.
+  std::size_t match(const char *begin, const char *end, std::size_t &rule) const noexcept
+  {
+    if (_accepts.empty())
     {
-      const char c = _content[_state.cur++];
+      return 0;
+    }
 
-      if (c == '\n')
+    std::size_t length = 0;
+    std::int32_t state = 0;
+
+    for (const char *p = begin; p < end; p++)
+    {
+      state = next(state, static_cast<unsigned char>(*p));
+
+      if (state == dead)
       {
-        _state.bol = _state.cur;
-        _state.row += 1;
+        break;
       }
 
-      return true;
+      if (accept(state) != no_rule)
+      {
+        length = static_cast<std::size_t>(p - begin) + 1;
+        rule = static_cast<std::size_t>(accept(state));
+      }
     }
 
-    return false;
+    return length;
   }
 
-  bool chop_characters(std::size_t n)
+  private:
+
+  using byte_set_t = std::bitset<256>;
+
+  struct nfa_state_t
   {
-    while (n-- > 0)
+    std::vector<std::size_t> epsilon;
+    byte_set_t bytes; // transition to `next` on any of these
+    std::size_t next = 0;
+    std::int32_t rule = no_rule;
+  };
+
+  struct nfa_t
+  {
+    std::size_t add_state()
     {
-      if (!chop_character())
-      {
-        return false;
-      }
+      states.emplace_back();
+      return states.size() - 1;
+    }
+
+    std::vector<nfa_state_t> states;
+  };
+
+  struct fragment_t
+  {
+    std::size_t start;
+    std::size_t end;
+  };
+
+  static fragment_t make_bytes(nfa_t &nfa, const byte_set_t &bytes)
+  {
+    const std::size_t start = nfa.add_state();
+    const std::size_t end = nfa.add_state();
+    nfa.states[start].bytes = bytes;
+    nfa.states[start].next = end;
+
+    return { start, end };
+  }
+
+  static fragment_t make_empty(nfa_t &nfa)
+  {
+    const std::size_t start = nfa.add_state();
+    const std::size_t end = nfa.add_state();
+    nfa.states[start].epsilon.push_back(end);
+
+    return { start, end };
+  }
+
+  static void add_class_escape(const char c, byte_set_t &bytes)
+  {
+    for (std::size_t b = 0; b < 256; b++)
+    {
+      const bool digit = std::isdigit(static_cast<int>(b));
+      const bool word = std::isalnum(static_cast<int>(b)) || b == '_';
+      const bool space = std::isspace(static_cast<int>(b));
+
+      if ((c == 'd' && digit) || (c == 'w' && word) || (c == 's' && space))
+      {
+        bytes.set(b);
+      }
+    }
+  }
+
+  static bool is_class_escape(const char c)
+  {
+    return c == 'd' || c == 'w' || c == 's';
+  }
+
+  static unsigned char unescape(const char c)
+  {
+    switch (c)
+    {
+      case 'n': return '\n';
+      case 't': return '\t';
+      case 'r': return '\r';
+      case '0': return '\0';
+      default: return static_cast<unsigned char>(c);
+    }
+  }
+
+  static bool parse_class(const char *&p, byte_set_t &bytes)
+  {
+    const bool negated = *p == '^';
+    if (negated)
+    {
+      p++;
+    }
+
+    bool first = true;
+    while (*p != ']' || first)
+    {
+      if (*p == '\0')
+      {
+        return false;
+      }
+
+      first = false;
+
+      unsigned char low = static_cast<unsigned char>(*p++);
+      if (low == '\\')
+      {
+        if (*p == '\0')
+        {
+          return false;
+        }
+
+        if (is_class_escape(*p))
+        {
+          add_class_escape(*p++, bytes);
+          continue;
+        }
+
+        low = unescape(*p++);
+      }
+
+      unsigned char high = low;
+      if (p[0] == '-' && p[1] != ']' && p[1] != '\0')
+      {
+        p++;
+        high = static_cast<unsigned char>(*p++);
+        if (high == '\\')
+        {
+          if (*p == '\0')
+          {
+            return false;
+          }
+
+          high = unescape(*p++);
+        }
+
+        if (high < low)
+        {
+          return false;
+        }
+      }
+
+      for (std::size_t b = low; b <= high; b++)
+      {
+        bytes.set(b);
+      }
+    }
+
+    p++; // ']'
+
+    if (negated)
+    {
+      bytes.flip();
+    }
+
+    return true;
+  }
+
+  static bool parse_atom(nfa_t &nfa, const char *&p, fragment_t &fragment)
+  {
+    byte_set_t bytes;
+
+    switch (*p)
+    {
+      case '(':
+      {
+        p++;
+        if (!parse_alternation(nfa, p, fragment) || *p != ')')
+        {
+          return false;
+        }
+
+        p++;
+        return true;
+      }
+
+      case '[':
+      {
+        p++;
+        if (!parse_class(p, bytes))
+        {
+          return false;
+        }
+
+        break;
+      }
+
+      case '.':
+      {
+        p++;
+        bytes.set();
+        bytes.reset('\n');
+
+        break;
+      }
+
+      case '\\':
+      {
+        p++;
+        if (*p == '\0')
+        {
+          return false;
+        }
+
+        if (is_class_escape(*p))
+        {
+          add_class_escape(*p++, bytes);
+        }
+        else
+        {
+          bytes.set(unescape(*p++));
+        }
+
+        break;
+      }
+
+      case '\0':
+      case ')':
+      case '|':
+      case '*':
+      case '+':
+      case '?':
+      {
+        return false;
+      }
+
+      default:
+      {
+        bytes.set(static_cast<unsigned char>(*p++));
+        break;
+      }
+    }
+
+    fragment = make_bytes(nfa, bytes);
+    return true;
+  }
+
+  static bool parse_repetition(nfa_t &nfa, const char *&p, fragment_t &fragment)
+  {
+    if (!parse_atom(nfa, p, fragment))
+    {
+      return false;
+    }
+
+    while (*p == '*' || *p == '+' || *p == '?')
+    {
+      const char op = *p++;
+
+      const std::size_t start = nfa.add_state();
+      const std::size_t end = nfa.add_state();
+
+      nfa.states[start].epsilon.push_back(fragment.start);
+      nfa.states[fragment.end].epsilon.push_back(end);
+
+      if (op != '+')
+      {
+        nfa.states[start].epsilon.push_back(end);
+      }
+
+      if (op != '?')
+      {
+        nfa.states[fragment.end].epsilon.push_back(fragment.start);
+      }
+
+      fragment = { start, end };
+    }
+
+    return true;
+  }
+
+  static bool parse_concatenation(nfa_t &nfa, const char *&p, fragment_t &fragment)
+  {
+    fragment = make_empty(nfa);
+
+    while (*p != '\0' && *p != '|' && *p != ')')
+    {
+      fragment_t next;
+      if (!parse_repetition(nfa, p, next))
+      {
+        return false;
+      }
+
+      nfa.states[fragment.end].epsilon.push_back(next.start);
+      fragment.end = next.end;
+    }
+
+    return true;
+  }
+
+  static bool parse_alternation(nfa_t &nfa, const char *&p, fragment_t &fragment)
+  {
+    if (!parse_concatenation(nfa, p, fragment))
+    {
+      return false;
+    }
+
+    while (*p == '|')
+    {
+      p++;
+
+      fragment_t other;
+      if (!parse_concatenation(nfa, p, other))
+      {
+        return false;
+      }
+
+      const std::size_t start = nfa.add_state();
+      const std::size_t end = nfa.add_state();
+
+      nfa.states[start].epsilon.insert(nfa.states[start].epsilon.end(), { fragment.start, other.start });
+      nfa.states[fragment.end].epsilon.push_back(end);
+      nfa.states[other.end].epsilon.push_back(end);
+
+      fragment = { start, end };
     }
 
     return true;
   }
 
-  bool chop_until_or_eol()
+  static void close(const nfa_t &nfa, std::vector<std::size_t> &set)
+  {
+    std::vector<bool> seen(nfa.states.size(), false);
+    std::vector<std::size_t> stack(set);
+
+    set.clear();
+    while (!stack.empty())
+    {
+      const std::size_t s = stack.back();
+      stack.pop_back();
+
+      if (seen[s])
+      {
+        continue;
+      }
+
+      seen[s] = true;
+      set.push_back(s);
+      stack.insert(stack.end(), nfa.states[s].epsilon.begin(), nfa.states[s].epsilon.end());
+    }
+
+    std::sort(set.begin(), set.end());
+  }
+
+  // the accepted rule of a set of nfa states: highest priority first, then earliest rule
+  std::int32_t best_rule(const nfa_t &nfa, const std::vector<std::size_t> &set) const
+  {
+    std::int32_t best = no_rule;
+
+    for (const std::size_t s : set)
+    {
+      const std::int32_t rule = nfa.states[s].rule;
+
+      if (rule != no_rule && (best == no_rule || _priorities[rule] > _priorities[best] || (_priorities[rule] == _priorities[best] && rule < best)))
+      {
+        best = rule;
+      }
+    }
+
+    return best;
+  }
+
+  // subset construction
+  void build_from(const nfa_t &nfa, const std::size_t start)
+  {
+    std::map<std::vector<std::size_t>, std::int32_t> ids;
+    std::vector<std::vector<std::size_t>> sets;
+
+    std::vector<std::size_t> initial{ start };
+    close(nfa, initial);
+
+    ids.emplace(initial, 0);
+    sets.push_back(initial);
+
+    for (std::size_t d = 0; d < sets.size(); d++)
+    {
+      _accepts.push_back(best_rule(nfa, sets[d]));
+      _transitions.resize(_transitions.size() + 256, dead);
+
+      for (std::size_t c = 0; c < 256; c++)
+      {
+        std::vector<std::size_t> target;
+        for (const std::size_t s : sets[d])
+        {
+          if (nfa.states[s].bytes.test(c))
+          {
+            target.push_back(nfa.states[s].next);
+          }
+        }
+
+        if (target.empty())
+        {
+          continue;
+        }
+
+        close(nfa, target);
+
+        const auto [it, inserted] = ids.emplace(target, static_cast<std::int32_t>(sets.size()));
+        if (inserted)
+        {
+          sets.push_back(target);
+        }
+
+        _transitions[d * 256 + c] = it->second;
+      }
+    }
+  }
+
+  // moore's partition refinement; blocks are renumbered by first appearance, so the start state stays 0
+  void minimize()
+  {
+    const std::size_t n = _accepts.size();
+
+    std::vector<std::int32_t> block(n);
+    for (std::size_t s = 0; s < n; s++)
+    {
+      block[s] = _accepts[s];
+    }
+
+    std::size_t count = 0;
+    while (true)
+    {
+      std::map<std::vector<std::int32_t>, std::int32_t> signatures;
+      std::vector<std::int32_t> refined(n);
+
+      for (std::size_t s = 0; s < n; s++)
+      {
+        std::vector<std::int32_t> signature;
+        signature.reserve(257);
+        signature.push_back(block[s]);
+
+        for (std::size_t c = 0; c < 256; c++)
+        {
+          const std::int32_t t = _transitions[s * 256 + c];
+          signature.push_back(t == dead ? dead : block[t]);
+        }
+
+        refined[s] = signatures.emplace(std::move(signature), static_cast<std::int32_t>(signatures.size())).first->second;
+      }
+
+      const bool stable = signatures.size() == count;
+      count = signatures.size();
+      block = std::move(refined);
+
+      if (stable)
+      {
+        break;
+      }
+    }
+
+    std::vector<std::int32_t> accepts(count, no_rule);
+    std::vector<std::int32_t> transitions(count * 256, dead);
+
+    for (std::size_t s = 0; s < n; s++)
+    {
+      const std::size_t b = static_cast<std::size_t>(block[s]);
+      accepts[b] = _accepts[s];
+
+      for (std::size_t c = 0; c < 256; c++)
+      {
+        const std::int32_t t = _transitions[s * 256 + c];
+        transitions[b * 256 + c] = t == dead ? dead : block[t];
+      }
+    }
+
+    _accepts = std::move(accepts);
+    _transitions = std::move(transitions);
+  }
+
+  std::vector<std::int32_t> _transitions; // 256 entries per state, `dead` if there is no transition
+  std::vector<std::int32_t> _accepts; // rule accepted in each state, or `no_rule`
+  std::vector<int> _priorities; // priority of each rule
+};
+
+// byte classes and first-byte dispatch tables of a config, for the flexers using it. a config compiles them every
+// time it changes, and all its copies and flexers share them, so constructing a flexer does not rebuild them.
+struct dispatch_tables_t
+{
+  struct entry_t
+  {
+    token_kind_t kind;
+    std::uint32_t index;
+  };
+
+  static constexpr std::size_t no_bracket = std::numeric_limits<std::size_t>::max();
+
+  std::array<bool, 256> space{};
+  std::array<bool, 256> symbol_start{};
+  std::array<bool, 256> symbol_continuation{};
+  std::array<bool, 256> junk{}; // bytes no token, comment or whitespace starts with, skipped at once by `recovery_t::skip_run`
+  std::array<bool, 256> sync{}; // bytes `recovery_t::skip_to_sync` stops at
+
+  // `junk` and `sync` as nibble tables for the vectorized skips: bit h % 8 of entry l + 16 * (h / 8) is set if the
+  // byte with high nibble h and low nibble l is in the set. derived from the byte tables, never serialized.
+  std::array<std::uint8_t, 32> junk_rows{};
+  std::array<std::uint8_t, 32> sync_rows{};
+  bool newline_in_punctuations = false; // whether a punctuation may span lines
+
+  std::vector<std::size_t> keyword_lengths;
+  std::vector<std::size_t> bracket_roles; // for every punctuation, `2 * pair` if it opens a bracket pair, `2 * pair + 1` if it closes one, or `no_bracket`
+
+  // for every possible first byte c, entries [offsets[c], offsets[c + 1]) list the keywords, comment delimiters and
+  // token classes that may start with it. token candidates keep the priority of `get_token`: punctuations in config
+  // order, then integer, symbol and strings. integers and symbols always succeed once they are reached, so nothing
+  // is listed after them.
+  std::array<std::uint32_t, 257> keyword_offsets{};
+  std::vector<std::uint32_t> keywords;
+
+  std::array<std::uint32_t, 257> comment_offsets{};
+  std::vector<std::uint32_t> comments;
+
+  std::array<std::uint32_t, 257> token_offsets{};
+  std::vector<entry_t> tokens;
+};
+
+struct config_t
+{
+  public:
+
+  config_t()
+  {
+    compile_tables();
+  }
+  
+  void configure_as_ansi_c()
+  {
+    add_ansi_c();
+    compile_tables();
+  }
+
+  void configure_as_c99()
+  {
+    add_c99();
+    compile_tables();
+  }
+
+  void configure_as_c11()
+  {
+    add_c11();
+    compile_tables();
+  }
+
+  void configure_as_c23()
+  {
+    add_c23();
+    compile_tables();
+  }
+
+  const char *get_symbol_starts() const
+  {
+    return _symbol_starts;
+  }
+
+  void set_symbol_starts(const char *symbol_starts)
+  {
+    _symbol_starts = symbol_starts;
+    compile_tables();
+  }
+
+  const char *get_symbol_continuations() const
+  {
+    return _symbol_continuations;
+  }
+
+  void set_symbol_continuations(const char *symbol_continuations)
+  {
+    _symbol_continuations = symbol_continuations;
+    compile_tables();
+  }
+
+  const std::vector<const char *> &get_punctuations() const
+  {
+    return _punctuations;
+  }
+
+  void set_punctuations(std::vector<const char *> &punctuations)
+  {
+    _punctuations = punctuations;
+    compile_tables();
+  }
+
+  const std::vector<const char *> &get_keywords() const
+  {
+    return _keywords;
+  }
+
+  void set_keywords(std::vector<const char *> &keywords)
+  {
+    _keywords = keywords;
+    compile_tables();
+  }
+
+  const std::vector<string_delimiter_t> &get_string_delimiters() const
+  {
+    return _string_delimiters;
+  }
+
+  void set_string_delimiters(std::vector<string_delimiter_t> &strings)
+  {
+    _string_delimiters = strings;
+    compile_tables();
+  }
+
+  const std::vector<string_escape_sequence_t> &get_string_escape_sequences() const
+  {
+    return _string_escape_sequences;
+  }
+
+  void set_string_escape_sequences(std::vector<string_escape_sequence_t> &string_escape_sequences)
+  {
+    _string_escape_sequences = string_escape_sequences;
+  }
+
+  const std::vector<comment_delimiter_t> &get_comment_delimiters() const
+  {
+    return _comment_delimiters;
+  }
+
+  void set_comment_delimiters(std::vector<comment_delimiter_t> &comment_delimiters)
+  {
+    _comment_delimiters = comment_delimiters;
+    compile_tables();
+  }
+
+  const std::vector<bracket_pair_t> &get_bracket_pairs() const
+  {
+    return _bracket_pairs;
+  }
+
+  void set_bracket_pairs(std::vector<bracket_pair_t> &bracket_pairs)
+  {
+    _bracket_pairs = bracket_pairs;
+    compile_tables();
+  }
+
+  const std::vector<token_rule_t> &get_rules() const
+  {
+    return _rules;
+  }
+
+  // replaces all rules at once and compiles them; keeps the previous rules if any pattern is malformed.
+  [[nodiscard]]
+  bool set_rules(const std::vector<token_rule_t> &rules)
+  {
+    auto dfa = std::make_shared<rule_dfa_t>();
+    if (!rule_dfa_t::compile(rules, *dfa))
+    {
+      return false;
+    }
+
+    _rules = rules;
+    _rules_dfa = rules.empty() ? nullptr : std::move(dfa);
+
+    compile_tables();
+
+    return true;
+  }
+
+  // recompiles all rules; prefer `set_rules` when adding many of them.
+  [[nodiscard]]
+  bool add_rule(const char *pattern, const int priority = 0)
+  {
+    std::vector<token_rule_t> rules = _rules;
+    rules.push_back({ pattern, priority });
+
+    return set_rules(rules);
+  }
+
+  std::shared_ptr<const rule_dfa_t> get_rules_dfa() const
+  {
+    return _rules_dfa;
+  }
+
+  std::shared_ptr<const dispatch_tables_t> get_dispatch_tables() const
+  {
+    return _tables;
+  }
+
+  recovery_t get_recovery() const
+  {
+    return _recovery;
+  }
+
+  void set_recovery(const recovery_t recovery)
+  {
+    _recovery = recovery;
+  }
+
+  const char *get_recovery_sync() const
+  {
+    return _recovery_sync;
+  }
+
+  // bytes `recovery_t::skip_to_sync` stops at, e.g. ";}\n"; "\n" by default, and an empty set stops at newlines too
+  void set_recovery_sync(const char *recovery_sync)
+  {
+    _recovery_sync = recovery_sync;
+    compile_tables();
+  }
+
+  // appends a compiled form of the config to `blob`: every list, the rules dfa and the dispatch tables, with the
+  // strings inline.
+  // the blob is relocatable and can be written to a file to be mapped later, or embedded as a constant array.
+  // it uses the native byte order and is meant to be read by the same build of flexer.
+  void serialize(std::vector<char> &blob) const
+  {
+    std::vector<std::uint32_t> words;
+    std::vector<char> pool;
+
+    const auto add_string = [&](const char *s)
+    {
+      words.push_back(static_cast<std::uint32_t>(pool.size()));
+      pool.insert(pool.end(), s, s + std::strlen(s) + 1);
+    };
+
+    add_string(_symbol_starts);
+    add_string(_symbol_continuations);
+
+    words.push_back(static_cast<std::uint32_t>(_keywords.size()));
+    for (const char *keyword : _keywords)
+    {
+      add_string(keyword);
+    }
+
+    words.push_back(static_cast<std::uint32_t>(_punctuations.size()));
+    for (const char *punctuation : _punctuations)
+    {
+      add_string(punctuation);
+    }
+
+    words.push_back(static_cast<std::uint32_t>(_string_delimiters.size()));
+    for (const string_delimiter_t &delimiter : _string_delimiters)
+    {
+      add_string(delimiter.opening);
+      add_string(delimiter.closing);
+    }
+
+    words.push_back(static_cast<std::uint32_t>(_string_escape_sequences.size()));
+    for (const string_escape_sequence_t &escape_sequence : _string_escape_sequences)
+    {
+      add_string(escape_sequence.escaped);
+      add_string(escape_sequence.unescaped);
+    }
+
+    words.push_back(static_cast<std::uint32_t>(_comment_delimiters.size()));
+    for (const comment_delimiter_t &delimiter : _comment_delimiters)
+    {
+      add_string(delimiter.opening);
+      add_string(delimiter.closing);
+      words.push_back(delimiter.accept_eof_as_closing ? 1 : 0);
+    }
+
+    words.push_back(static_cast<std::uint32_t>(_bracket_pairs.size()));
+    for (const bracket_pair_t &pair : _bracket_pairs)
+    {
+      words.push_back(static_cast<std::uint32_t>(pair.opening));
+      words.push_back(static_cast<std::uint32_t>(pair.closing));
+    }
+
+    words.push_back(static_cast<std::uint32_t>(_rules.size()));
+    for (const token_rule_t &rule : _rules)
+    {
+      add_string(rule.pattern);
+      words.push_back(static_cast<std::uint32_t>(rule.priority));
+    }
+
+    const std::size_t states = _rules_dfa ? _rules_dfa->get_state_count() : 0;
+    words.push_back(static_cast<std::uint32_t>(states));
+    if (states > 0)
+    {
+      words.insert(words.end(), _rules_dfa->get_transitions().begin(), _rules_dfa->get_transitions().end());
+      words.insert(words.end(), _rules_dfa->get_accepts().begin(), _rules_dfa->get_accepts().end());
+    }
+
+    words.push_back(static_cast<std::uint32_t>(_recovery));
+    add_string(_recovery_sync);
+
+    write_tables(*_tables, words);
+
+    const std::uint32_t header[4] = { blob_magic, blob_version, static_cast<std::uint32_t>(words.size()), static_cast<std::uint32_t>(pool.size()) };
+
+    const std::size_t offset = blob.size();
+    blob.resize(offset + sizeof(header) + words.size() * sizeof(std::uint32_t) + pool.size());
+
+    std::memcpy(blob.data() + offset, header, sizeof(header));
+    std::memcpy(blob.data() + offset + sizeof(header), words.data(), words.size() * sizeof(std::uint32_t));
+    std::memcpy(blob.data() + offset + sizeof(header) + words.size() * sizeof(std::uint32_t), pool.data(), pool.size());
+  }
+
+  // replaces the config with the one serialized in `blob`, without recompiling the rules or the dispatch tables.
+  // strings are not copied, so the blob must outlive the config and every flexer using it.
+  // returns false, leaving the config unchanged, if the blob is truncated, malformed, inconsistent with itself
+  // or of another version.
+  [[nodiscard]]
+  bool deserialize(const char *blob, const std::size_t size)
+  {
+    blob_reader_t reader(blob, size);
+    if (!reader.is_valid())
+    {
+      return false;
+    }
+
+    config_t config(uncompiled);
+    std::uint32_t count = 0;
+
+    if (!reader.read_string(config._symbol_starts) || !reader.read_string(config._symbol_continuations))
+    {
+      return false;
+    }
+
+    if (!reader.read_word(count))
+    {
+      return false;
+    }
+
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+      if (!reader.read_string(config._keywords.emplace_back()))
+      {
+        return false;
+      }
+    }
+
+    if (!reader.read_word(count))
+    {
+      return false;
+    }
+
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+      if (!reader.read_string(config._punctuations.emplace_back()))
+      {
+        return false;
+      }
+    }
+
+    if (!reader.read_word(count))
+    {
+      return false;
+    }
+
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+      string_delimiter_t &delimiter = config._string_delimiters.emplace_back();
+      if (!reader.read_string(delimiter.opening) || !reader.read_string(delimiter.closing))
+      {
+        return false;
+      }
+    }
+
+    if (!reader.read_word(count))
+    {
+      return false;
+    }
+
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+      string_escape_sequence_t &escape_sequence = config._string_escape_sequences.emplace_back();
+      if (!reader.read_string(escape_sequence.escaped) || !reader.read_string(escape_sequence.unescaped))
+      {
+        return false;
+      }
+    }
+
+    if (!reader.read_word(count))
+    {
+      return false;
+    }
+
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+      comment_delimiter_t &delimiter = config._comment_delimiters.emplace_back();
+      std::uint32_t accept_eof_as_closing = 0;
+
+      if (!reader.read_string(delimiter.opening) || !reader.read_string(delimiter.closing) || !reader.read_word(accept_eof_as_closing))
+      {
+        return false;
+      }
+
+      delimiter.accept_eof_as_closing = accept_eof_as_closing != 0;
+    }
+
+    if (!reader.read_word(count))
+    {
+      return false;
+    }
+
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+      std::uint32_t opening = 0;
+      std::uint32_t closing = 0;
+
+      if (!reader.read_word(opening) || !reader.read_word(closing))
+      {
+        return false;
+      }
+
+      config._bracket_pairs.push_back({ opening, closing });
+    }
+
+    if (!reader.read_word(count))
+    {
+      return false;
+    }
+
+    std::vector<int> priorities;
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+      token_rule_t &rule = config._rules.emplace_back();
+      std::uint32_t priority = 0;
+
+      if (!reader.read_string(rule.pattern) || !reader.read_word(priority))
+      {
+        return false;
+      }
+
+      rule.priority = static_cast<int>(priority);
+      priorities.push_back(rule.priority);
+    }
+
+    std::uint32_t states = 0;
+    if (!reader.read_word(states))
+    {
+      return false;
+    }
+
+    if (states > 0)
+    {
+      std::vector<std::int32_t> transitions;
+      std::vector<std::int32_t> accepts;
+
+      if (!reader.read_words(static_cast<std::size_t>(states) * 256, transitions) || !reader.read_words(states, accepts))
+      {
+        return false;
+      }
+
+      auto dfa = std::make_shared<rule_dfa_t>();
+      if (!rule_dfa_t::assign(std::move(transitions), std::move(accepts), std::move(priorities), *dfa))
+      {
+        return false;
+      }
+
+      config._rules_dfa = std::move(dfa);
+    }
+
+    std::uint32_t recovery = 0;
+    if (!reader.read_word(recovery) || recovery > static_cast<std::uint32_t>(recovery_t::skip_to_sync) || !reader.read_string(config._recovery_sync))
+    {
+      return false;
+    }
+
+    config._recovery = static_cast<recovery_t>(recovery);
+
+    auto tables = std::make_shared<dispatch_tables_t>();
+    if (!read_tables(reader, config, *tables) || !reader.is_exhausted())
+    {
+      return false;
+    }
+
+    config._tables = std::move(tables);
+
+    *this = std::move(config);
+    return true;
+  }
+
+  private:
+
+  // the lists of each language version, without compiling the tables, so that `configure_as_*` compiles them once
+  void add_ansi_c()
+  {
+    _symbol_starts = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_";
+    _symbol_continuations = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_0123456789";
+
+    _keywords.insert(_keywords.end(), { "auto", "break", "case", "char", "const", "continue", "default", "do", "double", "else", "enum", "extern", "float", "for", "goto", "if", "int", "long", "register", "return", "short", "signed", "sizeof", "static", "struct", "switch", "typedef", "union", "unsigned", "void", "volatile", "while" });
+    _punctuations.insert(_punctuations.end(), { "(", ")", "[", "]", "{", "}", "...", "*=", "/=", "%=", "+=", "-=", "<<=", ">>=", "&=", "^=", "|=", "->", "++", "--", "&", "*", "+", "-", "~", "!", "/", "%", "<<", ">>", "<=", ">=", "<", ">", "==", "!=", "^", "|", "&&", "||", "?", ":", ";", ".", "=", "," });
+    
+    _string_delimiters.insert(_string_delimiters.end(), { { "\"", "\"" }, { "\'", "\'" } });
+    _string_escape_sequences.insert(_string_escape_sequences.end(), { { "\\\"", "\"" }, { "\\\'", "\'" }, { "\\\\", "\\" }, { "\\a", "\a" }, { "\\b", "\b" }, { "\\f", "\f" }, { "\\n", "\n" }, { "\\r", "\r" }, { "\\t", "\t" }, { "\\v", "\v" } });
+    
+    _comment_delimiters.insert(_comment_delimiters.end(), { { "/*", "*/", false }, { "//", "\n", true } });
+
+    _bracket_pairs.insert(_bracket_pairs.end(), { { 0, 1 }, { 2, 3 }, { 4, 5 } }); // (), [], {}
+  }
+
+  void add_c99()
+  {
+    add_ansi_c();
+    _keywords.insert(_keywords.end(), { "inline", "restrict", "_Bool", "_Complex", "_Imaginary" });
+  }
+
+  void add_c11()
+  {
+    add_c99();
+    _keywords.insert(_keywords.end(), { "_Alignas", "_Alignof", "_Atomic", "_Generic", "_Noreturn", "_Static_assert", "_Thread_local" });
+  }
+
+  void add_c23()
+  {
+    add_c11();
+    _keywords.insert(_keywords.end(), { "alignas", "alignof", "bool", "constexpr", "false", "nullptr", "static_assert", "thread_local", "true", "typeof", "typeof_unqual", "_BitInt", "_Decimal128", "_Decimal32", "_Decimal64" });
+  }
+
+  struct uncompiled_t
+  {
+    explicit uncompiled_t() = default;
+  };
+
+  static constexpr uncompiled_t uncompiled{};
+
+  // for `deserialize`, which reads the tables from the blob instead
+  explicit config_t(uncompiled_t)
+  {
+    // nothing to do here!
+  }
+
+  // lists every entry under its first byte: counts them, turns the counts into offsets, then places them in order
+  template <typename first_byte_t>
+  static void bucket(const std::size_t count, const first_byte_t &first_byte, std::array<std::uint32_t, 257> &offsets, std::vector<std::uint32_t> &entries)
+  {
+    for (std::size_t i = 0; i < count; i++)
+    {
+      const unsigned char c = first_byte(i);
+      offsets[c + 1] += c != 0 ? 1 : 0;
+    }
+
+    for (std::size_t c = 0; c < 256; c++)
+    {
+      offsets[c + 1] += offsets[c];
+    }
+
+    std::array<std::uint32_t, 256> next;
+    std::copy(offsets.begin(), offsets.end() - 1, next.begin());
+
+    entries.resize(offsets[256]);
+    for (std::size_t i = 0; i < count; i++)
+    {
+      const unsigned char c = first_byte(i);
+
+      if (c != 0)
+      {
+        entries[next[c]++] = static_cast<std::uint32_t>(i);
+      }
+    }
+  }
+
+  void compile_tables()
+  {
+    auto tables = std::make_shared<dispatch_tables_t>();
+
+    for (const char *p = _symbol_starts; p && *p; p++)
+    {
+      tables->symbol_start[static_cast<unsigned char>(*p)] = true;
+    }
+
+    for (const char *p = _symbol_continuations; p && *p; p++)
+    {
+      tables->symbol_continuation[static_cast<unsigned char>(*p)] = true;
+    }
+
+    for (const char *p = _recovery_sync; p && *p; p++)
+    {
+      tables->sync[static_cast<unsigned char>(*p)] = true;
+    }
+
+    // an empty set would skip the rest of the input; skip the line instead
+    if (!_recovery_sync || !*_recovery_sync)
+    {
+      tables->sync['\n'] = true;
+    }
+
+    for (std::size_t c = 0; c < 256; c++)
+    {
+      tables->space[c] = std::isspace(static_cast<int>(c));
+    }
+
+    for (const char *keyword : _keywords)
+    {
+      tables->keyword_lengths.push_back(std::strlen(keyword));
+    }
+
+    for (const char *punctuation : _punctuations)
+    {
+      tables->newline_in_punctuations = tables->newline_in_punctuations || std::strchr(punctuation, '\n');
+    }
+
+    tables->bracket_roles.assign(_punctuations.size(), dispatch_tables_t::no_bracket);
+    for (std::size_t pair = 0; pair < _bracket_pairs.size(); pair++)
+    {
+      if (_bracket_pairs[pair].opening < _punctuations.size() && _bracket_pairs[pair].closing < _punctuations.size())
+      {
+        tables->bracket_roles[_bracket_pairs[pair].opening] = 2 * pair;
+        tables->bracket_roles[_bracket_pairs[pair].closing] = 2 * pair + 1;
+      }
+    }
+
+    bucket(_keywords.size(), [&](const std::size_t i) { return static_cast<unsigned char>(_keywords[i][0]); }, tables->keyword_offsets, tables->keywords);
+    bucket(_comment_delimiters.size(), [&](const std::size_t i) { return static_cast<unsigned char>(_comment_delimiters[i].opening[0]); }, tables->comment_offsets, tables->comments);
+
+    // token candidates: punctuations, then one integer or symbol entry, or else the strings
+    const auto is_word_start = [&](const unsigned char c) { return std::isdigit(static_cast<int>(c)) || tables->symbol_start[c]; };
+
+    std::vector<std::uint32_t> punctuations;
+    std::vector<std::uint32_t> strings;
+    std::array<std::uint32_t, 257> punctuation_offsets{};
+    std::array<std::uint32_t, 257> string_offsets{};
+
+    bucket(_punctuations.size(), [&](const std::size_t i) { return static_cast<unsigned char>(_punctuations[i][0]); }, punctuation_offsets, punctuations);
+    bucket(_string_delimiters.size(), [&](const std::size_t i) { return static_cast<unsigned char>(_string_delimiters[i].opening[0]); }, string_offsets, strings);
+
+    for (std::size_t c = 0; c < 256; c++)
+    {
+      tables->token_offsets[c] = static_cast<std::uint32_t>(tables->tokens.size());
+
+      for (std::uint32_t k = punctuation_offsets[c]; k < punctuation_offsets[c + 1]; k++)
+      {
+        tables->tokens.push_back({ token_kind_t::punctuation, punctuations[k] });
+      }
+
+      if (is_word_start(static_cast<unsigned char>(c)))
+      {
+        tables->tokens.push_back({ std::isdigit(static_cast<int>(c)) ? token_kind_t::integer : token_kind_t::symbol, 0 });
+        continue;
+      }
+
+      for (std::uint32_t k = string_offsets[c]; k < string_offsets[c + 1]; k++)
+      {
+        tables->tokens.push_back({ token_kind_t::string, strings[k] });
+      }
+    }
+
+    tables->token_offsets[256] = static_cast<std::uint32_t>(tables->tokens.size());
+
+    for (std::size_t c = 0; c < 256; c++)
+    {
+      const bool rule_start = _rules_dfa && _rules_dfa->get_state_count() > 0 && _rules_dfa->next(0, static_cast<unsigned char>(c)) != rule_dfa_t::dead;
+
+      tables->junk[c] = !tables->space[c] && !rule_start &&
+        tables->comment_offsets[c] == tables->comment_offsets[c + 1] &&
+        tables->token_offsets[c] == tables->token_offsets[c + 1];
+    }
+
+    compile_rows(tables->junk, tables->junk_rows);
+    compile_rows(tables->sync, tables->sync_rows);
+
+    _tables = std::move(tables);
+  }
+
+  // the nibble table of a byte set, see `dispatch_tables_t::junk_rows`
+  static void compile_rows(const std::array<bool, 256> &flags, std::array<std::uint8_t, 32> &rows)
+  {
+    rows.fill(0);
+
+    for (std::size_t c = 0; c < 256; c++)
+    {
+      if (flags[c])
+      {
+        rows[(c & 0x0f) + 16 * (c >> 7)] |= static_cast<std::uint8_t>(1u << ((c >> 4) & 7));
+      }
+    }
+  }
+
+  static constexpr std::uint32_t no_bracket_word = std::numeric_limits<std::uint32_t>::max();
+
+  static constexpr std::uint32_t blob_magic = 0x43584c46; // "FLXC" in little endian
+  static constexpr std::uint32_t blob_version = 3;
+
+  // reads the word stream and the string pool of a serialized config, checking every access
+  class blob_reader_t
+  {
+    public:
+
+    blob_reader_t(const char *blob, const std::size_t size) : _blob(blob), _cur(0), _words_end(0), _pool(0), _pool_size(0)
+    {
+      std::uint32_t header[4];
+      if (size < sizeof(header))
+      {
+        return;
+      }
+
+      std::memcpy(header, blob, sizeof(header));
+      if (header[0] != blob_magic || header[1] != blob_version || (size - sizeof(header)) / sizeof(std::uint32_t) < header[2])
+      {
+        return;
+      }
+
+      _cur = sizeof(header);
+      _words_end = _cur + header[2] * sizeof(std::uint32_t);
+      _pool = _words_end;
+
+      if (size - _pool < header[3])
+      {
+        _cur = _words_end = 0;
+        return;
+      }
+
+      // the blob may be followed by other data, which its strings must not reach into
+      _pool_size = header[3];
+    }
+
+    bool is_valid() const noexcept
+    {
+      return _words_end != 0;
+    }
+
+    // whether every word has been read
+    bool is_exhausted() const noexcept
+    {
+      return _cur == _words_end;
+    }
+
+    template <typename word_t>
+    bool read_word(word_t &word)
+    {
+      if (_words_end - _cur < sizeof(word_t))
+      {
+        return false;
+      }
+
+      std::memcpy(&word, _blob + _cur, sizeof(word_t));
+      _cur += sizeof(word_t);
+
+      return true;
+    }
+
+    template <typename word_t>
+    bool read_words(const std::size_t count, std::vector<word_t> &words)
+    {
+      if ((_words_end - _cur) / sizeof(word_t) < count)
+      {
+        return false;
+      }
+
+      words.resize(count);
+      std::memcpy(words.data(), _blob + _cur, count * sizeof(word_t));
+      _cur += count * sizeof(word_t);
+
+      return true;
+    }
+
+    bool read_string(const char *&s)
+    {
+      std::uint32_t offset = 0;
+      if (!read_word(offset) || offset >= _pool_size || !std::memchr(_blob + _pool + offset, '\0', _pool_size - offset))
+      {
+        return false;
+      }
+
+      s = _blob + _pool + offset;
+      return true;
+    }
+
+    private:
+
+    const char *_blob;
+    std::size_t _cur;
+    std::size_t _words_end;
+    std::size_t _pool;
+    std::size_t _pool_size; // from the header
+  };
+
+  // the dispatch tables in the word stream of a blob: byte tables as bitmaps, then lengths and roles, then the
+  // buckets as offsets followed by entries
+  static void write_tables(const dispatch_tables_t &tables, std::vector<std::uint32_t> &words)
+  {
+    for (const std::array<bool, 256> *flags : { &tables.space, &tables.symbol_start, &tables.symbol_continuation, &tables.junk, &tables.sync })
+    {
+      for (std::size_t c = 0; c < 256; c += 32)
+      {
+        std::uint32_t word = 0;
+        for (std::size_t bit = 0; bit < 32; bit++)
+        {
+          word |= (*flags)[c + bit] ? 1u << bit : 0;
+        }
+
+        words.push_back(word);
+      }
+    }
+
+    words.push_back(tables.newline_in_punctuations ? 1 : 0);
+
+    for (const std::size_t length : tables.keyword_lengths)
+    {
+      words.push_back(static_cast<std::uint32_t>(length));
+    }
+
+    for (const std::size_t role : tables.bracket_roles)
+    {
+      words.push_back(role == dispatch_tables_t::no_bracket ? no_bracket_word : static_cast<std::uint32_t>(role));
+    }
+
+    words.insert(words.end(), tables.keyword_offsets.begin(), tables.keyword_offsets.end());
+    words.insert(words.end(), tables.keywords.begin(), tables.keywords.end());
+
+    words.insert(words.end(), tables.comment_offsets.begin(), tables.comment_offsets.end());
+    words.insert(words.end(), tables.comments.begin(), tables.comments.end());
+
+    words.insert(words.end(), tables.token_offsets.begin(), tables.token_offsets.end());
+    for (const dispatch_tables_t::entry_t &entry : tables.tokens)
+    {
+      words.push_back(static_cast<std::uint32_t>(entry.kind));
+      words.push_back(entry.index);
+    }
+  }
+
+  // reads the tables written by `write_tables` for the lists of `config`, checking that every index the flexer
+  // will follow is in range and that every entry is listed under its own first byte
+  static bool read_tables(blob_reader_t &reader, const config_t &config, dispatch_tables_t &tables)
+  {
+    for (std::array<bool, 256> *flags : { &tables.space, &tables.symbol_start, &tables.symbol_continuation, &tables.junk, &tables.sync })
+    {
+      for (std::size_t c = 0; c < 256; c += 32)
+      {
+        std::uint32_t word = 0;
+        if (!reader.read_word(word))
+        {
+          return false;
+        }
+
+        for (std::size_t bit = 0; bit < 32; bit++)
+        {
+          (*flags)[c + bit] = (word >> bit) & 1;
+        }
+      }
+    }
+
+    // the sentinel of padded inputs must end every loop
+    if (tables.space[0] || tables.symbol_continuation[0])
+    {
+      return false;
+    }
+
+    compile_rows(tables.junk, tables.junk_rows);
+    compile_rows(tables.sync, tables.sync_rows);
+
+    std::uint32_t newline_in_punctuations = 0;
+    if (!reader.read_word(newline_in_punctuations) || newline_in_punctuations > 1)
+    {
+      return false;
+    }
+
+    tables.newline_in_punctuations = newline_in_punctuations != 0;
+
+    std::vector<std::uint32_t> words;
+
+    tables.keyword_lengths.reserve(config._keywords.size());
+    tables.bracket_roles.reserve(config._punctuations.size());
+
+    if (!reader.read_words(config._keywords.size(), words))
+    {
+      return false;
+    }
+
+    for (std::size_t i = 0; i < words.size(); i++)
+    {
+      if (words[i] != std::strlen(config._keywords[i]))
+      {
+        return false;
+      }
+
+      tables.keyword_lengths.push_back(words[i]);
+    }
+
+    if (!reader.read_words(config._punctuations.size(), words))
+    {
+      return false;
+    }
+
+    for (const std::uint32_t role : words)
+    {
+      if (role != no_bracket_word && role >= 2 * config._bracket_pairs.size())
+      {
+        return false;
+      }
+
+      tables.bracket_roles.push_back(role == no_bracket_word ? dispatch_tables_t::no_bracket : role);
+    }
+
+    // offsets must grow from 0 to the number of entries, which are then read. nothing starts with a zero byte.
+    const auto read_offsets = [&](std::array<std::uint32_t, 257> &offsets, const std::size_t entry_words, std::vector<std::uint32_t> &entries)
+    {
+      for (std::uint32_t &offset : offsets)
+      {
+        if (!reader.read_word(offset))
+        {
+          return false;
+        }
+      }
+
+      if (offsets[0] != 0 || offsets[1] != 0 || !std::is_sorted(offsets.begin(), offsets.end()))
+      {
+        return false;
+      }
+
+      return reader.read_words(static_cast<std::size_t>(offsets[256]) * entry_words, entries);
+    };
+
+    const auto first_byte = [](const char *s) { return static_cast<unsigned char>(s[0]); };
+
+    if (!read_offsets(tables.keyword_offsets, 1, tables.keywords))
+    {
+      return false;
+    }
+
+    for (std::size_t c = 0; c < 256; c++)
+    {
+      for (std::uint32_t k = tables.keyword_offsets[c]; k < tables.keyword_offsets[c + 1]; k++)
+      {
+        if (tables.keywords[k] >= config._keywords.size() || first_byte(config._keywords[tables.keywords[k]]) != c)
+        {
+          return false;
+        }
+      }
+    }
+
+    if (!read_offsets(tables.comment_offsets, 1, tables.comments))
+    {
+      return false;
+    }
+
+    for (std::size_t c = 0; c < 256; c++)
+    {
+      for (std::uint32_t k = tables.comment_offsets[c]; k < tables.comment_offsets[c + 1]; k++)
+      {
+        if (tables.comments[k] >= config._comment_delimiters.size() || first_byte(config._comment_delimiters[tables.comments[k]].opening) != c)
+        {
+          return false;
+        }
+      }
+    }
+
+    if (!read_offsets(tables.token_offsets, 2, words))
+    {
+      return false;
+    }
+
+    tables.tokens.reserve(tables.token_offsets[256]);
+
+    for (std::size_t c = 0; c < 256; c++)
+    {
+      for (std::uint32_t k = tables.token_offsets[c]; k < tables.token_offsets[c + 1]; k++)
+      {
+        if (words[2 * k] > static_cast<std::uint32_t>(token_kind_t::rule))
+        {
+          return false;
+        }
+
+        const token_kind_t kind = static_cast<token_kind_t>(words[2 * k]);
+        const std::uint32_t index = words[2 * k + 1];
+
+        switch (kind)
+        {
+          case token_kind_t::punctuation:
+          {
+            if (index >= config._punctuations.size() || first_byte(config._punctuations[index]) != c)
+            {
+              return false;
+            }
+
+            break;
+          }
+
+          case token_kind_t::string:
+          {
+            if (index >= config._string_delimiters.size() || first_byte(config._string_delimiters[index].opening) != c)
+            {
+              return false;
+            }
+
+            break;
+          }
+
+          // both consume their first byte, or the scan would not move on
+          case token_kind_t::integer:
+          {
+            if (!std::isdigit(static_cast<int>(c)))
+            {
+              return false;
+            }
+
+            break;
+          }
+
+          case token_kind_t::symbol:
+          {
+            if (!tables.symbol_continuation[c])
+            {
+              return false;
+            }
+
+            break;
+          }
+
+          default:
+          {
+            return false;
+          }
+        }
+
+        tables.tokens.push_back({ kind, index });
+      }
+    }
+
+    return true;
+  }
+
+
+  std::vector<const char *> _keywords; // if one of the keywords is a prefix of another one, the longer one should come first.
+  std::vector<const char *> _punctuations; // if one of the punctuations is a prefix of another one, the longer one should come first.
+
+  const char *_symbol_starts = "";
+  const char *_symbol_continuations = "";
+
+  std::vector<string_delimiter_t> _string_delimiters;
+  std::vector<string_escape_sequence_t> _string_escape_sequences;
+  std::vector<comment_delimiter_t> _comment_delimiters;
+
+  std::vector<bracket_pair_t> _bracket_pairs;
+
+  std::vector<token_rule_t> _rules;
+  std::shared_ptr<const rule_dfa_t> _rules_dfa; // shared by all copies of the config and all flexers using it
+
+  recovery_t _recovery = recovery_t::none;
+  const char *_recovery_sync = "\n";
+
+  std::shared_ptr<const dispatch_tables_t> _tables; // shared like `_rules_dfa`, recompiled whenever the config changes
+};
+
+// a copy of an input followed by `sentinel_padding` zero bytes, for inputs that are not padded already
+class padded_buffer_t
+{
+  public:
+
+  padded_buffer_t(const char *content, const std::size_t size, std::pmr::memory_resource *resource = std::pmr::get_default_resource()) : _data(size + sentinel_padding, '\0', resource)
+  {
+    std::memcpy(_data.data(), content, size);
+  }
+
+  const char *data() const noexcept
+  {
+    return _data.data();
+  }
+
+  std::size_t size() const noexcept
+  {
+    return _data.size() - sentinel_padding;
+  }
+
+  private:
+
+  std::pmr::vector<char> _data;
+};
+
+class flexer
+{
+  public:
+
+  flexer(const config_t &config, const char *content, const char *filename = default_filename, std::pmr::memory_resource *resource = std::pmr::get_default_resource()) : 
+    flexer(config, content, std::strlen(content), filename, source_location_t{}, false, resource)
+  {
+    // nothing to do here!
+  }
+
+  // lexes `size` bytes of `content`, which must be followed by `sentinel_padding` readable bytes, the first one zero
+  // (see `padded_buffer_t`). the scanners then stop at the sentinel instead of checking bounds on every byte.
+  flexer(const config_t &config, const char *content, const std::size_t size, padded_input_t, const char *filename = default_filename, std::pmr::memory_resource *resource = std::pmr::get_default_resource()) : 
+    flexer(config, content, size, filename, source_location_t{}, true, resource)
+  {
+    // nothing to do here!
+  }
+
+  // lexes a buffer registered in `sources`. tokens keep only their 32-bit source location, which decodes through
+  // `sources` (see `token_t::get_location(sources)`).
+  flexer(const config_t &config, const source_manager_t &sources, const file_id_t file, std::pmr::memory_resource *resource = std::pmr::get_default_resource()) : 
+    flexer(config, sources.get_content(file), sources.get_size(file), sources.get_filename(file), sources.get_source_location(file, 0), false, resource)
+  {
+    // nothing to do here!
+  }
+
+  [[nodiscard]]
+  bool get_current_char(char &c)
+  {
+    if (_state.cur >= _size)
+    {
+      return false;
+    }
+
+    c = _content[_state.cur];
+    return true;
+  }
+
+  [[nodiscard]]
+  bool get_next_char(char &c)
+  {
+    if (_state.cur + 1 >= _size)
+    {
+      return false;
+    }
+
+    c = _content[_state.cur + 1];
+    return true;
+  }
+
+  bool chop_character()
+  {
+    if (_state.cur < _size)
+    {
+      const char c = _content[_state.cur++];
+
+      if (c == '\n')
+      {
+        _state.bol = _state.cur;
+        _state.row += 1;
+      }
+
+      return true;
+    }
+
+    return false;
+  }
+
+  bool chop_characters(std::size_t n)
+  {
+    while (n-- > 0)
+    {
+      if (!chop_character())
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool chop_until_or_eol()
+  {
+    while (_state.cur < _size && _content[_state.cur] != '\n')
+    {
+      if (!chop_character())
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool chop_until_prefix_or_eof(const char *prefix)
+  {
+    while (_state.cur < _size)
+    {
+      if (starts_with(prefix))
+      {
+        return true;
+      }
+
+      chop_character();
+    }
+
+    return false;
+  }
+
+  bool chop_until_prefix_eol(const char *prefix)
+  {
+    while (!starts_with(prefix))
+    {
+      if (_state.cur >= _size || _content[_state.cur] == '\n')
+      {
+        return false;
+      }
+
+      if (!chop_character())
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  void trim_left()
+  {
+    while (_state.cur < _size && _tables->space[static_cast<unsigned char>(_content[_state.cur])])
+    {
+      if (!chop_character())
+      {
+        return;
+      }
+    }
+  }
+
+  location_t get_location() const
+  {
+    return location_t(_filename, _state.row + 1, _state.cur - _state.bol + 1);
+  }
+
+  // invalid if the flexer is not attached to a source manager
+  source_location_t get_source_location() const
+  {
+    if (!_source_base.is_valid())
+    {
+      return source_location_t{};
+    }
+
+    return source_location_t(_source_base.raw() + static_cast<std::uint32_t>(_state.cur));
+  }
+
+  bool is_symbol_start(const char c)
+  {
+    return _tables->symbol_start[static_cast<unsigned char>(c)];
+  }
+
+  bool is_symbol_continuation(const char c)
+  {
+    return _tables->symbol_continuation[static_cast<unsigned char>(c)];
+  }
+
+  bool starts_with(const char *prefix)
+  {
+    return starts_with_at<false>(_state.cur, prefix);
+  }
+
+  bool get_token(token_t &t)
+  {
+    return _padded ? get_token<true>(t) : get_token<false>(t);
+  }
+
+  bool is_padded() const noexcept
+  {
+    return _padded;
+  }
+
+  // scans the whole input, independently of the current state, reporting tokens to `policy` without decoding
+  // their values or tracking their locations. tokens go through the same recognizer as `get_token`, and so does
+  // invalid input: without a recovery mode an invalid byte is reported as an invalid token and skipped, and an
+  // unterminated comment or string as an invalid token that ends the scan. the index of an invalid token is
+  // its `diagnostic_t`. returns false if any invalid token was reported.
+  template <typename policy_t>
+  bool scan(policy_t &policy)
+  {
+    const bool ok = _padded ? recognize<true>(0, policy) : recognize<false>(0, policy);
+
+    if constexpr (policy_t::track_lines)
+    {
+      policy.on_end(_size > 0 && _content[_size - 1] != '\n');
+    }
+
+    return ok;
+  }
+
+  // pushes every token to the handlers of `visitor`, with no intermediate token and no virtual calls.
+  // all handlers are optional, and values are only decoded for the handlers that exist:
+  //   on_symbol(std::string_view text), on_keyword(std::size_t index), on_punctuation(std::size_t index),
+  //   on_integer(std::ptrdiff_t value), on_string(std::size_t index, std::string_view value),
+  //   on_rule(std::size_t index, std::string_view text), on_invalid(std::string_view text) and on_eof().
+  // locations are not tracked, and invalid input is handled as in `scan`.
+  template <typename visitor_t>
+  bool lex(visitor_t &visitor)
+  {
+    visitor_policy_t<visitor_t> policy(*this, visitor);
+    return scan(policy);
+  }
+
+  // indexes the whole input
+  void build_checkpoints(checkpoint_index_t &index)
+  {
+    extend_checkpoints(index, _size);
+  }
+
+  // appends the tokens overlapping [begin, end) to `tokens`, lexing from the nearest checkpoint instead of the
+  // beginning of the input, and extending the index as needed. eof, at offset `size`, is appended if the range
+  // reaches it, so `[x, size)` ends with eof like `tokenize` does.
+  // stops at the first invalid token unless there is a recovery mode, and returns false if any was lexed.
+  // the state of the flexer is left unchanged.
+  bool lex_range(checkpoint_index_t &index, const std::size_t begin, const std::size_t end, token_list_t &tokens)
+  {
+    extend_checkpoints(index, begin);
+
+    const state_t saved = _state;
+    _state = index.find(begin);
+
+    bool ok = true;
+    token_t t(tokens.get_allocator());
+
+    while (true)
+    {
+      const bool lexed = get_token(t);
+
+      if (t.get_begin() >= _content + end && (t.get_kind() != token_kind_t::eof || end < _size))
+      {
+        break;
+      }
+
+      if (t.get_end() > _content + begin || t.get_kind() == token_kind_t::eof)
+      {
+        tokens.push_back(t);
+      }
+
+      if (!lexed)
+      {
+        ok = false;
+
+        if (_recovery == recovery_t::none)
+        {
+          break;
+        }
+      }
+
+      if (t.get_kind() == token_kind_t::eof)
+      {
+        break;
+      }
+    }
+
+    _state = saved;
+    return ok;
+  }
+
+  // appends tokens to `tokens` until eof (which is appended as well) or the first invalid token, or with a
+  // recovery mode until eof, keeping the invalid tokens in the list. returns false if there was any.
+  // tokens are constructed with the allocator of `tokens`, so their string payloads live in the same arena.
+  bool tokenize(token_list_t &tokens)
+  {
+    bool ok = true;
+
+    while (true)
+    {
+      token_t &t = tokens.emplace_back();
+
+      if (!get_token(t))
+      {
+        ok = false;
+
+        if (_recovery == recovery_t::none)
+        {
+          return false;
+        }
+      }
+
+      if (t.get_kind() == token_kind_t::eof)
+      {
+        return ok;
+      }
+    }
+  }
+
+  // same as `tokenize`, also matching the bracket pairs of the config in `brackets`.
+  // returns false on an invalid token, which ends it as in `tokenize`; unbalanced brackets are reported by `brackets` only.
+  bool tokenize(token_list_t &tokens, bracket_index_t &brackets)
+  {
+    bool ok = true;
+
+    while (true)
+    {
+      token_t &t = tokens.emplace_back();
+
+      if (!get_token(t))
+      {
+        ok = false;
+
+        if (_recovery == recovery_t::none)
+        {
+          break;
+        }
+      }
+
+      if (t.get_kind() == token_kind_t::eof)
+      {
+        break;
+      }
+
+      if (t.get_kind() == token_kind_t::punctuation)
+      {
+        const std::size_t role = _tables->bracket_roles[t.get_index()];
+
+        if (role != dispatch_tables_t::no_bracket)
+        {
+          if (role % 2 == 0)
+          {
+            brackets.add_opening(tokens.size() - 1, role / 2);
+          }
+          else
+          {
+            brackets.add_closing(tokens.size() - 1, role / 2);
+          }
+        }
+      }
+    }
+
+    brackets.finish();
+    return ok;
+  }
+
+  std::pmr::memory_resource *get_memory_resource() const noexcept
+  {
+    return _resource;
+  }
+
+  state_t get_state() const
+  {
+    return _state;
+  }
+
+  void set_state(const state_t state)
+  {
+    _state = state;
+  }
+
+  private:
+
+  flexer(const config_t &config, const char *content, const std::size_t size, const char *filename, const source_location_t source_base, const bool padded, std::pmr::memory_resource *resource) : 
+    _content(content),
+    _size(size),
+    _padded(padded),
+    _filename(filename), 
+    _source_base(source_base),
+    _resource(resource),
+    _recovery(config.get_recovery()),
+    _punctuations(config.get_punctuations().begin(), config.get_punctuations().end(), resource),
+    _keywords(config.get_keywords().begin(), config.get_keywords().end(), resource),
+    _string_delimiters(config.get_string_delimiters().begin(), config.get_string_delimiters().end(), resource),
+    _string_escape_sequences(config.get_string_escape_sequences().begin(), config.get_string_escape_sequences().end(), resource),
+    _comment_delimiters(config.get_comment_delimiters().begin(), config.get_comment_delimiters().end(), resource),
+    _rules_dfa(config.get_rules_dfa()),
+    _tables(config.get_dispatch_tables())
+  {
+    // nothing to do here!
+  }
+
+  // lexes from where `index` stopped until past `offset`, recording a checkpoint at the first token boundary
+  // after every multiple of the interval
+  void extend_checkpoints(checkpoint_index_t &index, const std::size_t offset)
+  {
+    if (index._complete || index._resume.cur > offset)
+    {
+      return;
+    }
+
+    const state_t saved = _state;
+    _state = index._resume;
+
+    std::size_t next = (_state.cur / index._interval + 1) * index._interval;
+    token_t t(_resource);
+
+    while (_state.cur <= offset)
+    {
+      get_token(t);
+
+      if (t.get_kind() == token_kind_t::eof)
+      {
+        index._complete = true;
+        break;
+      }
+
+      if (_state.cur >= next)
+      {
+        index._checkpoints.push_back(_state);
+        next = (_state.cur / index._interval + 1) * index._interval;
+      }
+    }
+
+    index._resume = _state;
+    _state = saved;
+  }
+
+  template <typename visitor_t>
+  class visitor_policy_t
+  {
+    public:
+
+    static constexpr bool track_lines = false;
+
+    visitor_policy_t(const flexer &owner, visitor_t &visitor) : _owner(owner), _visitor(visitor), _value_string(owner._resource)
+    {
+      // nothing to do here!
+    }
+
+    void on_token(const token_kind_t kind, const std::size_t index, const char *begin, const char *end)
+    {
+      const std::string_view text{ begin, static_cast<std::size_t>(end - begin) };
+
+      switch (kind)
+      {
+        case token_kind_t::invalid:
+        {
+          if constexpr (requires { _visitor.on_invalid(text); })
+          {
+            _visitor.on_invalid(text);
+          }
+
+          break;
+        }
+
+        case token_kind_t::eof:
+        {
+          if constexpr (requires { _visitor.on_eof(); })
+          {
+            _visitor.on_eof();
+          }
+
+          break;
+        }
+
+        case token_kind_t::integer:
+        {
+          if constexpr (requires { _visitor.on_integer(std::ptrdiff_t{}); })
+          {
+            _visitor.on_integer(decode_integer(begin, end));
+          }
+
+          break;
+        }
+
+        case token_kind_t::symbol:
+        {
+          if constexpr (requires { _visitor.on_symbol(text); })
+          {
+            _visitor.on_symbol(text);
+          }
+
+          break;
+        }
+
+        case token_kind_t::keyword:
+        {
+          if constexpr (requires { _visitor.on_keyword(index); })
+          {
+            _visitor.on_keyword(index);
+          }
+
+          break;
+        }
+
+        case token_kind_t::punctuation:
+        {
+          if constexpr (requires { _visitor.on_punctuation(index); })
+          {
+            _visitor.on_punctuation(index);
+          }
+
+          break;
+        }
+
+        case token_kind_t::string:
+        {
+          if constexpr (requires { _visitor.on_string(index, text); })
+          {
+            _owner.unescape_string(index, begin, end, _value_string);
+            _visitor.on_string(index, std::string_view{ _value_string });
+          }
+
+          break;
+        }
+
+        case token_kind_t::rule:
+        {
+          if constexpr (requires { _visitor.on_rule(index, text); })
+          {
+            _visitor.on_rule(index, text);
+          }
+
+          break;
+        }
+      }
+    }
+
+    private:
+
+    const flexer &_owner;
+    visitor_t &_visitor;
+    std::pmr::string _value_string; // reused for every string token
+  };
+
+  // the policy behind `get_token`: moves the state of the flexer along, and locates and decodes the token into `t`
+  class token_policy_t
+  {
+    public:
+
+    static constexpr bool track_lines = false;
+
+    token_policy_t(flexer &owner, token_t &t) : _owner(owner), _t(t)
+    {
+      // nothing to do here!
+    }
+
+    void on_line(const std::size_t bol)
+    {
+      _owner._state.row += 1;
+      _owner._state.bol = bol;
+    }
+
+    void on_token(const token_kind_t kind, const std::size_t index, const char *begin, const char *end)
+    {
+      _owner._state.cur = static_cast<std::size_t>(begin - _owner._content);
+      _owner.locate(_t);
+
+      _t.set_kind(kind);
+      _t.set_begin(begin);
+      _t.set_end(end);
+
+      switch (kind)
+      {
+        case token_kind_t::invalid:
+        {
+          _t.set_diagnostic(static_cast<diagnostic_t>(index));
+          break;
+        }
+
+        case token_kind_t::integer:
+        {
+          _t.value_integer() = decode_integer(begin, end);
+          break;
+        }
+
+        case token_kind_t::string:
+        {
+          _t.set_index(index);
+          _owner.unescape_string(index, begin, end, _t.value_string());
+          break;
+        }
+
+        case token_kind_t::keyword:
+        case token_kind_t::punctuation:
+        case token_kind_t::rule:
+        {
+          _t.set_index(index);
+          break;
+        }
+
+        default:
+        {
+          break;
+        }
+      }
+
+      _owner._state.cur = static_cast<std::size_t>(end - _owner._content);
+    }
+
+    private:
+
+    flexer &_owner;
+    token_t &_t;
+  };
+
+  static std::ptrdiff_t decode_integer(const char *begin, const char *end)
+  {
+    std::ptrdiff_t value = 0;
+    for (const char *p = begin; p < end; p++)
+    {
+      value *= 10;
+      value += *p - '0';
+    }
+
+    return value;
+  }
+
+  // the value of string token [begin, end) delimited by string delimiter `i`
+  void unescape_string(const std::size_t i, const char *begin, const char *end, std::pmr::string &value) const
+  {
+    std::size_t cur = static_cast<std::size_t>(begin - _content) + std::strlen(_string_delimiters[i].opening);
+    const std::size_t stop = static_cast<std::size_t>(end - _content) - std::strlen(_string_delimiters[i].closing);
+
+    value.clear();
+
+    while (cur < stop)
+    {
+      bool escape_sequence_encountered = false;
+
+      for (const string_escape_sequence_t &escape_sequence : _string_escape_sequences)
+      {
+        if (starts_with_at(cur, escape_sequence.escaped))
+        {
+          escape_sequence_encountered = true;
+          cur += std::strlen(escape_sequence.escaped);
+          value += escape_sequence.unescaped;
+
+          break;
+        }
+      }
+
+      if (!escape_sequence_encountered)
+      {
+        value += _content[cur++];
+      }
+    }
+  }
+
+  // only the keywords starting with the same character are compared, in config order
+  bool find_keyword(const char *begin, const std::size_t n, std::size_t &index) const
   {
-    while (_state.cur < _size && _content[_state.cur] != '\n')
+    const unsigned char first = static_cast<unsigned char>(begin[0]);
+
+    for (std::uint32_t k = _tables->keyword_offsets[first]; k < _tables->keyword_offsets[first + 1]; k++)
     {
-      if (!chop_character())
+      const std::size_t i = _tables->keywords[k];
+
+      if (_tables->keyword_lengths[i] == n && std::memcmp(_keywords[i], begin, n) == 0)
       {
-        return false;
+        index = i;
+        return true;
       }
     }
 
-    return true;
+    return false;
   }
 
-bool chop_until_prefix_or_eof(const char *prefix)
-{
-  while (_state.cur < _size)
+  // position of the first occurrence of `s` at or after `cur`, or `_size` if there is none
+  std::size_t find_at(std::size_t cur, const char *s) const
   {
-    if (starts_with(prefix))
+    if (!*s)
     {
-      return true;
+      return _size;
     }
 
-    chop_character();
-  }
-
-  return false;
-}
-
-  bool chop_until_prefix_eol(const char *prefix)
-  {
-    while (!starts_with(prefix))
+    while (cur < _size)
     {
-      if (_state.cur >= _size || _content[_state.cur] == '\n')
+      const char *p = static_cast<const char *>(std::memchr(_content + cur, s[0], _size - cur));
+      if (!p)
       {
-        return false;
+        return _size;
       }
 
-      if (!chop_character())
+      cur = static_cast<std::size_t>(p - _content);
+      if (starts_with_at(cur, s))
       {
-        return false;
+        return cur;
       }
+
+      cur++;
     }
 
-    return true;
+    return _size;
   }
 
-  void trim_left()
+  template <typename policy_t>
+  static constexpr bool tracks_bol = requires (policy_t &policy) { policy.on_line(std::size_t{}); };
+
+  // reports the newlines inside [begin, end) to `policy`, and whether a comment or a token continues after them
+  template <typename policy_t>
+  void scan_lines(policy_t &policy, const std::size_t begin, const std::size_t end, const bool comment) const
   {
-    while (_state.cur < _size && std::isspace(static_cast<unsigned char>(_content[_state.cur])))
+    if constexpr (policy_t::track_lines || tracks_bol<policy_t>)
     {
-      if (!chop_character())
+      for (const char *p = _content + begin; (p = static_cast<const char *>(std::memchr(p, '\n', static_cast<std::size_t>(_content + end - p)))) != nullptr; p++)
       {
-        return;
+        if constexpr (policy_t::track_lines)
+        {
+          policy.on_newline();
+
+          if (p + 1 < _content + end)
+          {
+            policy.on_continuation(comment);
+          }
+        }
+
+        if constexpr (tracks_bol<policy_t>)
+        {
+          policy.on_line(static_cast<std::size_t>(p - _content) + 1);
+        }
       }
     }
   }
 
-  location_t get_location() const
-  {
-    return location_t(_filename, _state.row + 1, _state.cur - _state.bol + 1);
-  }
-
-  bool is_symbol_start(const char c)
+  // integers and symbols are made of digits and symbol continuations, which are not expected to be newlines
+  bool may_span_lines(const token_kind_t kind) const
   {
-    return std::strchr(_symbol_starts, c) != nullptr;
-  }
+    switch (kind)
+    {
+      case token_kind_t::eof:
+      case token_kind_t::integer:
+      {
+        return false;
+      }
 
-  bool is_symbol_continuation(const char c)
-  {
-    return std::strchr(_symbol_continuations, c) != nullptr;
-  }
+      case token_kind_t::symbol:
+      case token_kind_t::keyword:
+      {
+        return _tables->symbol_continuation['\n'];
+      }
 
-  bool starts_with(const char *prefix)
-  {
-    if (!*prefix)
-    {
-      return false;
-    }
+      case token_kind_t::punctuation:
+      {
+        return _tables->newline_in_punctuations;
+      }
 
-    for (std::size_t i = 0; prefix[i] != '\0'; i++)
-    {
-      if (_state.cur + i >= _size || _content[_state.cur + i] != prefix[i])
+      default:
       {
-          return false;
+        return true;
       }
     }
-
-    return true;
   }
 
+  // instances of `get_token` for bounded and padded inputs
+  template <bool padded>
   bool get_token(token_t &t)
   {
-    t = token_t{};
+    t.reset();
 
-    while (_state.cur < _size)
+    token_policy_t policy(*this, t);
+    return recognize<padded>(_state.cur, policy);
+  }
+
+  // the one recognizer behind `get_token` and `scan`: from `cur`, skips whitespace and comments, recognizes the
+  // next token and reports it to `policy`, until eof has been reported, or only once for `token_policy_t`.
+  // a policy with `on_line(bol)` is also told where every line it goes past starts. returns false if any invalid
+  // token was reported.
+  template <bool padded, typename policy_t>
+  bool recognize(std::size_t cur, policy_t &policy) const
+  {
+    bool ok = true;
+
+    while (true)
     {
-      trim_left();
+      token_kind_t kind = token_kind_t::eof;
+      std::size_t index = 0;
+      std::size_t end = _size;
 
-      bool removed_comment = false;
+      bool unterminated_comment = false;
 
-      // comments
-      for (std::size_t i = 0; i < _comment_delimiters.size(); i++)
+      while (true)
       {
-        const char *opening = _comment_delimiters[i].opening;
-        const char *closing = _comment_delimiters[i].closing;
-        bool accept_eof_as_closing = _comment_delimiters[i].accept_eof_as_closing;
-
-        if (starts_with(opening))
+        while ((padded || cur < _size) && _tables->space[static_cast<unsigned char>(_content[cur])])
         {
-          chop_characters(strlen(opening));
-          if (!chop_until_prefix_or_eof(closing))
+          if constexpr (policy_t::track_lines || tracks_bol<policy_t>)
           {
-            if (accept_eof_as_closing)
+            if (_content[cur] == '\n')
             {
-              if (_state.cur != _state.bol)
+              if constexpr (policy_t::track_lines)
               {
-                _state.row += 1;
-                _state.bol = _state.cur;
+                policy.on_newline();
               }
-              removed_comment = true;
 
-              break;
+              if constexpr (tracks_bol<policy_t>)
+              {
+                policy.on_line(cur + 1);
+              }
             }
+          }
 
-            return false;
+          cur++;
+        }
+
+        if (cur >= _size)
+        {
+          break;
+        }
+
+        // comments, only those whose opening starts with the current character
+        const unsigned char first = static_cast<unsigned char>(_content[cur]);
+        bool removed_comment = false;
+
+        for (std::uint32_t k = _tables->comment_offsets[first]; k < _tables->comment_offsets[first + 1]; k++)
+        {
+          const comment_delimiter_t &delimiter = _comment_delimiters[_tables->comments[k]];
+
+          if (!starts_with_at<padded>(cur, delimiter.opening))
+          {
+            continue;
+          }
+
+          const std::size_t body = cur + std::strlen(delimiter.opening);
+          std::size_t closing = find_closing<padded>(body, delimiter.closing);
+
+          if (closing >= _size && !delimiter.accept_eof_as_closing)
+          {
+            kind = token_kind_t::invalid;
+            index = static_cast<std::size_t>(diagnostic_t::unterminated_comment);
+            end = _recovery == recovery_t::none ? _size : find_recovery_end(body, true);
+            unterminated_comment = true;
+
+            break;
+          }
+
+          if (closing < _size && !delimiter.accept_eof_as_closing)
+          {
+            closing += std::strlen(delimiter.closing);
           }
 
-          if (!accept_eof_as_closing)
+          if constexpr (policy_t::track_lines)
           {
-            chop_characters(strlen(closing));
+            policy.on_comment();
           }
 
+          scan_lines(policy, cur, closing, true);
+
+          cur = closing;
           removed_comment = true;
           break; // restart trim
         }
+
+        if (!removed_comment)
+        {
+          break;
+        }
       }
 
-      if (!removed_comment)
+      if (cur >= _size)
       {
-        break;
+        cur = _size;
+      }
+      else if (!unterminated_comment)
+      {
+        kind = token_kind_t::invalid;
+        end = measure_token<padded>(cur, kind, index);
       }
-    }
 
-    t.set_location(get_location());
-    t.set_begin(_content + _state.cur);
-    t.set_end(_content + _state.cur);
+      policy.on_token(kind, index, _content + cur, _content + end);
 
-    // eof
-    if (_state.cur >= _size)
-    {
-      t.set_kind(token_kind_t::eof);
-      return true;
-    }
+      if (may_span_lines(kind))
+      {
+        scan_lines(policy, cur, end, false);
+      }
 
-    // punctuations
-    for (std::size_t i = 0; i < _punctuations.size(); i++)
-    {
-      if (starts_with(_punctuations[i]))
+      ok = ok && kind != token_kind_t::invalid;
+      cur = end;
+
+      if (kind == token_kind_t::eof || std::is_same_v<policy_t, token_policy_t>)
       {
-        size_t n = std::strlen(_punctuations[i]);
-        t.set_kind(token_kind_t::punctuation);
-        t.set_index(i);
-        t.set_end(t.get_end() + n);
-        chop_characters(n);
-    
-        return true;
+        return ok;
       }
     }
+  }
 
-    // integer
-    if (std::isdigit(static_cast<unsigned char>(_content[_state.cur])))
+  // with a padded input, a mismatch at the sentinel at the latest ends the comparison
+  template <bool padded = false>
+  bool starts_with_at(const std::size_t cur, const char *prefix) const
+  {
+    if (!*prefix)
     {
-      t.set_kind(token_kind_t::integer);
-      while (_state.cur < _size && std::isdigit(static_cast<unsigned char>(_content[_state.cur])))
-      {
-        t.value_integer() *= 10;
-        t.value_integer() += _content[_state.cur] - '0';
+      return false;
+    }
 
-        t.set_end(t.get_end() + 1);
-        chop_character();
+    for (std::size_t i = 0; prefix[i] != '\0'; i++)
+    {
+      if ((!padded && cur + i >= _size) || _content[cur + i] != prefix[i])
+      {
+          return false;
       }
-    
-      return true;
     }
 
-    // symbol
-    if (is_symbol_start(_content[_state.cur]))
+    return true;
+  }
+
+  // position of the first occurrence of `s` at or after `cur`, or `_size` if there is none
+  template <bool padded>
+  std::size_t find_closing(std::size_t cur, const char *s) const
+  {
+    if constexpr (padded)
     {
-      t.set_kind(token_kind_t::symbol);
-      while (_state.cur < _size && is_symbol_continuation(_content[_state.cur]))
+      if (!*s)
       {
-        t.set_end(t.get_end() + 1);
-        chop_character();
+        return _size;
       }
 
-      // keyword
-      for (std::size_t i = 0; i < _keywords.size(); i++)
+      // jump from one zero byte or candidate to the next, 16 bytes at a time
+      while (true)
       {
-        size_t n = std::strlen(_keywords[i]);
-        if (n == static_cast<std::size_t>(t.get_end() - t.get_begin()) && std::memcmp(_keywords[i], t.get_begin(), n) == 0)
+        cur = find_stop(cur, s[0]);
+
+        if (_content[cur] == '\0' && cur >= _size)
         {
-          t.set_kind(token_kind_t::keyword);
-          t.set_index(i);
-          break;
+          return _size;
+        }
+
+        if (starts_with_at<true>(cur, s))
+        {
+          return cur;
         }
+
+        cur++;
       }
-      
-      return true;
     }
 
-    // string
-    for (std::size_t i = 0; i < _string_delimiters.size(); i++)
+    return find_at(cur, s);
+  }
+
+  // end of the token at `cur`; without a recovery mode an unlexable byte is an invalid token of
+  // length one, and an unterminated string an invalid token running to the end of the input.
+  template <bool padded>
+  std::size_t measure_token(const std::size_t cur, token_kind_t &kind, std::size_t &index) const
+  {
+    std::size_t end = measure_builtin<padded>(cur, kind, index);
+
+    std::size_t rule = 0;
+    const std::size_t rule_length = _rules_dfa ? _rules_dfa->match(_content + cur, _content + _size, rule) : 0;
+
+    if (rule_length == 0)
+    {
+      return end;
+    }
+
+    if (kind != token_kind_t::invalid && (end - cur > rule_length || (end - cur == rule_length && _rules_dfa->priority(rule) <= 0)))
+    {
+      return end;
+    }
+
+    kind = token_kind_t::rule;
+    index = rule;
+
+    return cur + rule_length;
+  }
+
+  template <bool padded>
+  std::size_t measure_builtin(const std::size_t cur, token_kind_t &kind, std::size_t &index) const
+  {
+    const unsigned char first = static_cast<unsigned char>(_content[cur]);
+
+    for (std::uint32_t k = _tables->token_offsets[first]; k < _tables->token_offsets[first + 1]; k++)
     {
-      const char *opening = _string_delimiters[i].opening;
-      const char *closing = _string_delimiters[i].closing;
+      const dispatch_tables_t::entry_t &entry = _tables->tokens[k];
 
-      if (starts_with(opening))
+      switch (entry.kind)
       {
-        chop_characters(strlen(opening));
-        t.value_string().reserve(16);
+        case token_kind_t::punctuation:
+        {
+          if (starts_with_at<padded>(cur, _punctuations[entry.index]))
+          {
+            kind = token_kind_t::punctuation;
+            index = entry.index;
+
+            return cur + std::strlen(_punctuations[entry.index]);
+          }
+
+          break;
+        }
 
-        do
+        case token_kind_t::integer:
         {
-          if (starts_with(closing))
+          std::size_t end = cur;
+          while ((padded || end < _size) && std::isdigit(static_cast<unsigned char>(_content[end])))
           {
-            break;
+            end++;
           }
 
-          bool escape_sequence_encountered = false;
+          kind = token_kind_t::integer;
+          return end;
+        }
 
-          if (_state.cur >= _size)
+        case token_kind_t::symbol:
+        {
+          std::size_t end = cur;
+          while ((padded || end < _size) && _tables->symbol_continuation[static_cast<unsigned char>(_content[end])])
           {
-            return false;
+            end++;
           }
 
-          // string escaping
-          for (std::size_t j = 0; j < _string_escape_sequences.size(); j++)
+          kind = find_keyword(_content + cur, end - cur, index) ? token_kind_t::keyword : token_kind_t::symbol;
+          return end;
+        }
+
+        case token_kind_t::string:
+        {
+          const string_delimiter_t &delimiter = _string_delimiters[entry.index];
+
+          if (!starts_with_at<padded>(cur, delimiter.opening))
           {
-            const char *escaped = _string_escape_sequences[j].escaped;
-            const char *unescaped = _string_escape_sequences[j].unescaped;
+            break;
+          }
 
-            if (starts_with(escaped))
+          std::size_t end = cur + std::strlen(delimiter.opening);
+
+          while (!starts_with_at<padded>(end, delimiter.closing))
+          {
+            if ((!padded || _content[end] == '\0') && end >= _size)
             {
-              escape_sequence_encountered = true;
-              chop_characters(strlen(escaped));
-              t.value_string() += unescaped;
+              kind = token_kind_t::invalid;
+              index = static_cast<std::size_t>(diagnostic_t::unterminated_string);
 
-              break;            
+              return _recovery == recovery_t::none ? _size : find_recovery_end(cur + std::strlen(delimiter.opening), true);
             }
-          }
 
-          if (!escape_sequence_encountered)
-          {
-            if (!chop_character())
+            std::size_t n = 1;
+            for (const string_escape_sequence_t &escape_sequence : _string_escape_sequences)
             {
-              return false;
+              if (starts_with_at<padded>(end, escape_sequence.escaped))
+              {
+                n = std::strlen(escape_sequence.escaped);
+                break;
+              }
             }
 
-            t.value_string() += _content[_state.cur - 1];
+            end += n;
           }
-        } while (!starts_with(closing));
 
-        chop_characters(strlen(closing));
+          kind = token_kind_t::string;
+          index = entry.index;
 
-        t.set_kind(token_kind_t::string);
-        t.set_index(i);
-        t.set_end(_content + _state.cur);
+          return end + std::strlen(delimiter.closing);
+        }
 
-        return true;
+        default:
+        {
+          break;
+        }
       }
     }
 
-    chop_character();
-    t.set_end(t.get_end() + 1);
-    
-    return false;
+    kind = token_kind_t::invalid;
+    index = static_cast<std::size_t>(diagnostic_t::unexpected_character);
+
+    return _recovery == recovery_t::none ? cur + 1 : find_recovery_end(cur + 1, false);
   }
 
-  state_t get_state() const
+  // end of the invalid input for the recovery mode, given `cur` just past the byte that could not be lexed or
+  // past the opening of an unterminated comment or string. such an opening is not followed by a run of junk,
+  // so `skip_run` resumes on the next line after it. the byte ending the skip is left for the next token.
+  std::size_t find_recovery_end(std::size_t cur, const bool unterminated) const
   {
-    return _state;
+    switch (_recovery)
+    {
+      case recovery_t::skip_run:
+      {
+        if (!unterminated)
+        {
+          return find_class(cur, _tables->junk, _tables->junk_rows, false);
+        }
+
+        [[fallthrough]];
+      }
+
+      case recovery_t::skip_line:
+      {
+        const char *p = cur < _size ? static_cast<const char *>(std::memchr(_content + cur, '\n', _size - cur)) : nullptr;
+        return p ? static_cast<std::size_t>(p - _content) : _size;
+      }
+
+      case recovery_t::skip_to_sync:
+      {
+        return find_class(cur, _tables->sync, _tables->sync_rows, true);
+      }
+
+      default:
+      {
+        return cur;
+      }
+    }
   }
 
-  void set_state(const state_t state)
+  // stores the current location in `t`: its source location if attached to a source manager, its location otherwise
+  void locate(token_t &t) const
   {
-    _state = state;
+    if (_source_base.is_valid())
+    {
+      t.set_source_location(get_source_location());
+      return;
+    }
+
+    t.set_location(get_location());
   }
 
-  private:
+  // first position at or after `cur`, or `_size`, whose byte is in `set` if `member`, not in it otherwise. on cpus
+  // with ssse3, whole blocks inside the input are classified at once through the nibble table `rows`.
+  std::size_t find_class(std::size_t cur, const std::array<bool, 256> &set, const std::array<std::uint8_t, 32> &rows, const bool member) const
+  {
+#if FLEXER_HAS_SSSE3
+    if (has_ssse3())
+    {
+      cur = find_class_blocks(cur, rows, member);
+    }
+#else
+    static_cast<void>(rows);
+#endif
+
+    while (cur < _size && set[static_cast<unsigned char>(_content[cur])] != member)
+    {
+      cur++;
+    }
+
+    return cur;
+  }
+
+#if FLEXER_HAS_SSSE3
+  static bool has_ssse3()
+  {
+#if defined(__SSSE3__)
+    return true;
+#else
+    __builtin_cpu_init(); // in case the flexer runs before the static constructors
+    return __builtin_cpu_supports("ssse3");
+#endif
+  }
+
+  // `find_class` over the whole blocks from `cur`: the position of the first byte found, or where the blocks end
+  __attribute__((target("ssse3")))
+  std::size_t find_class_blocks(std::size_t cur, const std::array<std::uint8_t, 32> &rows, const bool member) const
+  {
+    const __m128i low_rows = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows.data()));
+    const __m128i high_rows = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows.data() + 16));
+    const __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    const __m128i seven = _mm_set1_epi8(7);
+    const unsigned flip = member ? 0 : 0xffff;
+
+    for (; cur + 16 <= _size; cur += 16)
+    {
+      const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(_content + cur));
+      const __m128i low = _mm_and_si128(block, nibble);
+      const __m128i high = _mm_and_si128(_mm_srli_epi16(block, 4), nibble);
+
+      const __m128i upper = _mm_cmpgt_epi8(high, seven);
+      const __m128i row = _mm_or_si128(_mm_andnot_si128(upper, _mm_shuffle_epi8(low_rows, low)), _mm_and_si128(upper, _mm_shuffle_epi8(high_rows, low)));
+      const __m128i bit = _mm_shuffle_epi8(bits, high);
+
+      const unsigned mask = (static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(row, bit), bit))) ^ flip);
+
+      if (mask != 0)
+      {
+        return cur + static_cast<std::size_t>(std::countr_zero(mask));
+      }
+    }
+
+    return cur;
+  }
+#endif
+
+  // first position at or after `cur` holding `c` or a zero byte; padded inputs only, since whole blocks are
+  // loaded and the sentinel is where the search ends at the latest
+  std::size_t find_stop(std::size_t cur, const char c) const
+  {
+#if defined(__SSE2__)
+    const __m128i wanted = _mm_set1_epi8(c);
+    const __m128i zero = _mm_setzero_si128();
+
+    while (true)
+    {
+      const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(_content + cur));
+      const __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(block, wanted), _mm_cmpeq_epi8(block, zero));
+      const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+
+      if (mask != 0)
+      {
+        return cur + static_cast<std::size_t>(std::countr_zero(mask));
+      }
+
+      cur += 16;
+    }
+#else
+    while (_content[cur] != c && _content[cur] != '\0')
+    {
+      cur++;
+    }
+
+    return cur;
+#endif
+  }
 
   const char *_content;
   std::size_t _size;
+  bool _padded; // `_content[_size]` is a zero sentinel followed by padding
 
   const char *_filename;
+  source_location_t _source_base; // address of the first character, if attached to a source manager
+
+  std::pmr::memory_resource *_resource;
 
   state_t _state;
 
-  const char *_symbol_starts;
-  const char *_symbol_continuations;
+  recovery_t _recovery;
+
+  const std::pmr::vector<const char *> _punctuations; // If one of the punctuations is a prefix of another one, the longer one should come first.
+  const std::pmr::vector<const char *> _keywords; // If one of the keywords is a prefix of another one, the longer one should come first.
+
+  const std::pmr::vector<string_delimiter_t> _string_delimiters;
+  const std::pmr::vector<string_escape_sequence_t> _string_escape_sequences;
+  const std::pmr::vector<comment_delimiter_t> _comment_delimiters;
 
-  const std::vector<const char *> _punctuations; // If one of the punctuations is a prefix of another one, the longer one should come first.
-  const std::vector<const char *> _keywords; // If one of the keywords is a prefix of another one, the longer one should come first.
+  const std::shared_ptr<const rule_dfa_t> _rules_dfa; // null if the config has no rules
 
-  const std::vector<string_delimiter_t> _string_delimiters;
-  const std::vector<string_escape_sequence_t> _string_escape_sequences;
-  const std::vector<comment_delimiter_t> _comment_delimiters;
+  const std::shared_ptr<const dispatch_tables_t> _tables; // compiled by the config
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,729 @@
+#pragma once
+
+// POSIX input helpers for batch lexing; not needed by flexer.hpp itself.
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "flexer.hpp"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(__NR_io_uring_register)
+#define FLEXER_HAS_IO_URING 1
+#endif
+#endif
+
+#ifndef FLEXER_HAS_IO_URING
+#define FLEXER_HAS_IO_URING 0
+#endif
+
+namespace flexer
+{
+
+// a read-only memory mapping of a whole file, e.g. a config serialized by `config_t::serialize`:
+//
+//   flexer::mapped_file_t blob;
+//   if (blob.open("c23.flexer") && config.deserialize(blob.data(), blob.size())) { ... }
+class mapped_file_t
+{
+  public:
+
+  mapped_file_t() = default;
+
+  mapped_file_t(const mapped_file_t &) = delete;
+  mapped_file_t &operator=(const mapped_file_t &) = delete;
+
+  ~mapped_file_t()
+  {
+    close();
+  }
+
+  [[nodiscard]]
+  bool open(const char *filename)
+  {
+    close();
+
+    const int fd = ::open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+      return false;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+    {
+      ::close(fd);
+      return false;
+    }
+
+    void *data = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (data == MAP_FAILED)
+    {
+      return false;
+    }
+
+    _data = static_cast<const char *>(data);
+    _size = static_cast<std::size_t>(st.st_size);
+
+    return true;
+  }
+
+  void close()
+  {
+    if (_data)
+    {
+      ::munmap(const_cast<char *>(_data), _size);
+    }
+
+    _data = nullptr;
+    _size = 0;
+  }
+
+  const char *data() const noexcept
+  {
+    return _data;
+  }
+
+  std::size_t size() const noexcept
+  {
+    return _size;
+  }
+
+  private:
+
+  const char *_data = nullptr;
+  std::size_t _size = 0;
+};
+
+// a file loaded by `batch_reader_t`. `content` is followed by `sentinel_padding` zero bytes, so it can be lexed
+// as a padded input, and stays valid until the file is released.
+struct loaded_file_t
+{
+  const char *filename;
+  const char *content;
+  std::size_t size;
+  bool ok; // false if the file could not be opened or read
+  std::size_t slot;
+};
+
+// loads a list of files in order, keeping up to `depth` reads in flight so that the next files are already
+// loading while the current one is lexed. reads go through io_uring where available (Linux 5.6 and later),
+// and otherwise through a pool of threads calling `pread`. files whose size is not known in advance, such as
+// pipes, `/dev/stdin` or `/proc` files, are read with `read` up to their end, synchronously when io_uring is
+// used. buffers are recycled: release every file once done with it.
+//
+//   flexer::batch_reader_t reader(filenames);
+//   flexer::loaded_file_t file;
+//   while (reader.next(file)) { ...; reader.release(file); }
+class batch_reader_t
+{
+  public:
+
+  explicit batch_reader_t(const std::vector<const char *> &filenames, const std::size_t depth = 8, const bool use_io_uring = true) :
+    _filenames(filenames),
+    _slots(depth < 1 ? 1 : depth)
+  {
+    if (!use_io_uring || !setup_io_uring())
+    {
+      for (std::size_t i = 0; i < _slots.size(); i++)
+      {
+        _workers.emplace_back([this]() { work(); });
+      }
+    }
+  }
+
+  batch_reader_t(const batch_reader_t &) = delete;
+  batch_reader_t &operator=(const batch_reader_t &) = delete;
+
+  ~batch_reader_t()
+  {
+    // the kernel or the workers may still be writing into the buffers
+    while (!_pending.empty())
+    {
+      wait_for(_pending.front());
+      close_slot(_slots[_pending.front()]);
+      _pending.pop_front();
+    }
+
+    if (_workers.empty())
+    {
+      teardown_io_uring();
+      return;
+    }
+
+    {
+      std::lock_guard lock(_mutex);
+      _stopping = true;
+    }
+
+    _jobs_changed.notify_all();
+    for (std::thread &worker : _workers)
+    {
+      worker.join();
+    }
+  }
+
+  bool is_using_io_uring() const noexcept
+  {
+    return _workers.empty();
+  }
+
+  // blocks until the next file is loaded; returns false once every file has been handed out
+  [[nodiscard]]
+  bool next(loaded_file_t &file)
+  {
+    fill();
+
+    if (_pending.empty())
+    {
+      return false;
+    }
+
+    const std::size_t s = _pending.front();
+    _pending.pop_front();
+
+    wait_for(s);
+
+    slot_t &slot = _slots[s];
+    close_slot(slot);
+    slot.status = status_t::handed_out;
+
+    if (slot.ok)
+    {
+      std::memset(slot.buffer.get() + slot.size, 0, sentinel_padding);
+      file = { _filenames[slot.file], slot.buffer.get(), slot.size, true, s };
+    }
+    else
+    {
+      static constexpr char empty[sentinel_padding] = {};
+      file = { _filenames[slot.file], empty, 0, false, s };
+    }
+
+    fill();
+    return true;
+  }
+
+  void release(const loaded_file_t &file)
+  {
+    _slots[file.slot].status = status_t::free;
+    fill();
+  }
+
+  private:
+
+  enum class status_t
+  {
+    free,
+    reading,
+    done,
+    handed_out,
+  };
+
+  struct slot_t
+  {
+    std::unique_ptr<char[]> buffer;
+    std::size_t capacity = 0;
+    std::size_t file = 0;
+    std::size_t size = 0;
+    std::size_t offset = 0;
+    int fd = -1;
+    bool stream = false; // the size is unknown, `size` grows as the file is read
+    bool ok = false;
+    status_t status = status_t::free;
+  };
+
+  // opens the file of `slot` and makes room for its content and the padding
+  static bool open_slot(slot_t &slot, const char *filename)
+  {
+    slot.fd = ::open(filename, O_RDONLY | O_CLOEXEC);
+    if (slot.fd < 0)
+    {
+      return false;
+    }
+
+    struct stat st;
+    if (::fstat(slot.fd, &st) != 0 || S_ISDIR(st.st_mode))
+    {
+      return false;
+    }
+
+    // some regular files, like those of `/proc`, report a size of 0 and still have a content
+    slot.stream = !S_ISREG(st.st_mode) || st.st_size == 0;
+    slot.size = slot.stream ? 0 : static_cast<std::size_t>(st.st_size);
+    slot.offset = 0;
+
+    if (slot.capacity < slot.size + sentinel_padding)
+    {
+      slot.capacity = std::max(slot.size + sentinel_padding, slot.capacity * 2);
+      slot.buffer = std::make_unique_for_overwrite<char[]>(slot.capacity);
+    }
+
+    return true;
+  }
+
+  // reads the rest of a file of known size with `pread`; a file that shrank since `fstat` keeps what was read
+  static bool read_rest(slot_t &slot)
+  {
+    while (slot.offset < slot.size)
+    {
+      const ssize_t n = ::pread(slot.fd, slot.buffer.get() + slot.offset, slot.size - slot.offset, static_cast<off_t>(slot.offset));
+
+      if (n < 0 && errno == EINTR)
+      {
+        continue;
+      }
+
+      if (n <= 0)
+      {
+        slot.size = slot.offset;
+        return n == 0;
+      }
+
+      slot.offset += static_cast<std::size_t>(n);
+    }
+
+    return true;
+  }
+
+  // reads a file of unknown size with `read` up to its end, growing the buffer as needed
+  static bool read_stream(slot_t &slot)
+  {
+    static constexpr std::size_t chunk = 64 * 1024;
+
+    while (true)
+    {
+      if (slot.capacity < slot.size + chunk + sentinel_padding)
+      {
+        const std::size_t capacity = std::max(slot.size + chunk + sentinel_padding, slot.capacity * 2);
+        std::unique_ptr<char[]> buffer = std::make_unique_for_overwrite<char[]>(capacity);
+
+        if (slot.size > 0)
+        {
+          std::memcpy(buffer.get(), slot.buffer.get(), slot.size);
+        }
+
+        slot.buffer = std::move(buffer);
+        slot.capacity = capacity;
+      }
+
+      const ssize_t n = ::read(slot.fd, slot.buffer.get() + slot.size, slot.capacity - sentinel_padding - slot.size);
+
+      if (n < 0 && errno == EINTR)
+      {
+        continue;
+      }
+
+      if (n <= 0)
+      {
+        return n == 0;
+      }
+
+      slot.size += static_cast<std::size_t>(n);
+    }
+  }
+
+  static bool read_slot(slot_t &slot)
+  {
+    return slot.stream ? read_stream(slot) : read_rest(slot);
+  }
+
+  static void close_slot(slot_t &slot)
+  {
+    if (slot.fd >= 0)
+    {
+      ::close(slot.fd);
+      slot.fd = -1;
+    }
+  }
+
+  // starts loading the next files into the free slots, in order
+  void fill()
+  {
+    for (std::size_t s = 0; s < _slots.size() && _next_file < _filenames.size(); s++)
+    {
+      if (!is_free(s))
+      {
+        continue;
+      }
+
+      slot_t &slot = _slots[s];
+      slot.file = _next_file++;
+      slot.ok = false;
+      slot.status = status_t::reading;
+      _pending.push_back(s);
+
+      if (!_workers.empty())
+      {
+        {
+          std::lock_guard lock(_mutex);
+          _jobs.push_back(s);
+        }
+
+        _jobs_changed.notify_one();
+        continue;
+      }
+
+      if (!open_slot(slot, _filenames[slot.file]))
+      {
+        slot.status = status_t::done;
+        continue;
+      }
+
+      if (slot.stream)
+      {
+        // there is no size to submit a read for; pipes may block here until their writer is done
+        slot.ok = read_stream(slot);
+        slot.status = status_t::done;
+        continue;
+      }
+
+      submit_read(s);
+    }
+  }
+
+  // workers set the status of the slots they read to `done` under `_mutex`; a free slot is never touched by
+  // them, so once free it stays free until `fill` hands it out again
+  bool is_free(const std::size_t s)
+  {
+    if (!_workers.empty())
+    {
+      std::lock_guard lock(_mutex);
+      return _slots[s].status == status_t::free;
+    }
+
+    return _slots[s].status == status_t::free;
+  }
+
+  void wait_for(const std::size_t s)
+  {
+    if (!_workers.empty())
+    {
+      std::unique_lock lock(_mutex);
+      _job_done.wait(lock, [&]() { return _slots[s].status == status_t::done; });
+
+      return;
+    }
+
+    while (_slots[s].status == status_t::reading)
+    {
+      if (!reap_completions())
+      {
+        wait_for_completions();
+      }
+    }
+  }
+
+  // thread pool fallback
+
+  void work()
+  {
+    while (true)
+    {
+      std::size_t s;
+
+      {
+        std::unique_lock lock(_mutex);
+        _jobs_changed.wait(lock, [&]() { return _stopping || !_jobs.empty(); });
+
+        if (_jobs.empty())
+        {
+          return;
+        }
+
+        s = _jobs.front();
+        _jobs.pop_front();
+      }
+
+      slot_t &slot = _slots[s];
+      const bool ok = open_slot(slot, _filenames[slot.file]) && read_slot(slot);
+
+      {
+        std::lock_guard lock(_mutex);
+        slot.ok = ok;
+        slot.status = status_t::done;
+      }
+
+      _job_done.notify_all();
+    }
+  }
+
+  // io_uring, through the raw system calls so that liburing is not required
+
+#if FLEXER_HAS_IO_URING
+
+  bool setup_io_uring()
+  {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    _ring_fd = static_cast<int>(::syscall(__NR_io_uring_setup, static_cast<unsigned>(_slots.size()), &params));
+    if (_ring_fd < 0)
+    {
+      return false;
+    }
+
+    _sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    _cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+    _sq_ring = ::mmap(nullptr, _sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_SQ_RING);
+    _cq_ring = ::mmap(nullptr, _cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_CQ_RING);
+    _sqes = ::mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_SQES);
+
+    if (_sq_ring == MAP_FAILED || _cq_ring == MAP_FAILED || _sqes == MAP_FAILED)
+    {
+      teardown_io_uring();
+      return false;
+    }
+
+    char *sq = static_cast<char *>(_sq_ring);
+    _sq_head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    _sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    _sq_mask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    _sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+
+    char *cq = static_cast<char *>(_cq_ring);
+    _cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    _cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    _cq_mask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    _cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    // on Linux 5.1 to 5.5 every read would complete with -EINVAL
+    if (!supports_read())
+    {
+      teardown_io_uring();
+      return false;
+    }
+
+    return true;
+  }
+
+  // whether the kernel knows IORING_OP_READ; kernels older than the opcode also lack IORING_REGISTER_PROBE
+  bool supports_read() const
+  {
+    static constexpr std::size_t max_ops = 256;
+
+    // `io_uring_probe` ends with a flexible array of `max_ops` entries
+    std::vector<std::uint64_t> buffer((sizeof(io_uring_probe) + max_ops * sizeof(io_uring_probe_op)) / sizeof(std::uint64_t), 0);
+    io_uring_probe *probe = reinterpret_cast<io_uring_probe *>(buffer.data());
+
+    if (::syscall(__NR_io_uring_register, _ring_fd, IORING_REGISTER_PROBE, probe, static_cast<unsigned>(max_ops)) < 0)
+    {
+      return false;
+    }
+
+    return IORING_OP_READ < probe->ops_len && (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) != 0;
+  }
+
+  void teardown_io_uring()
+  {
+    if (_sqes && _sqes != MAP_FAILED)
+    {
+      ::munmap(_sqes, _sqes_size);
+    }
+
+    if (_cq_ring && _cq_ring != MAP_FAILED)
+    {
+      ::munmap(_cq_ring, _cq_ring_size);
+    }
+
+    if (_sq_ring && _sq_ring != MAP_FAILED)
+    {
+      ::munmap(_sq_ring, _sq_ring_size);
+    }
+
+    if (_ring_fd >= 0)
+    {
+      ::close(_ring_fd);
+    }
+
+    _sqes = _cq_ring = _sq_ring = nullptr;
+    _ring_fd = -1;
+  }
+
+  int enter(const unsigned to_submit, const unsigned min_complete, const unsigned flags)
+  {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, _ring_fd, to_submit, min_complete, flags, nullptr, 0));
+  }
+
+  void wait_for_completions()
+  {
+    enter(0, 1, IORING_ENTER_GETEVENTS);
+  }
+
+  // never more reads are in flight than there are slots, so the submission queue cannot overflow.
+  // if the submission fails, the slot is read with `pread` instead so that `wait_for` does not wait for it.
+  void submit_read(const std::size_t s)
+  {
+    slot_t &slot = _slots[s];
+
+    const unsigned tail = *_sq_tail;
+    const unsigned index = tail & _sq_mask;
+
+    io_uring_sqe &sqe = static_cast<io_uring_sqe *>(_sqes)[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_READ;
+    sqe.fd = slot.fd;
+    sqe.addr = reinterpret_cast<std::uint64_t>(slot.buffer.get() + slot.offset);
+    sqe.len = static_cast<std::uint32_t>(std::min<std::size_t>(slot.size - slot.offset, 1u << 30));
+    sqe.off = slot.offset;
+    sqe.user_data = s;
+
+    _sq_array[index] = index;
+    __atomic_store_n(_sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    int submitted;
+    while ((submitted = enter(1, 0, 0)) < 0 && errno == EINTR)
+    {
+      // retry
+    }
+
+    // the kernel did not take the entry: withdraw it, or a later submission would send it along
+    if (submitted < 0 && __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE) == tail)
+    {
+      __atomic_store_n(_sq_tail, tail, __ATOMIC_RELEASE);
+
+      slot.ok = read_rest(slot);
+      slot.status = status_t::done;
+    }
+  }
+
+  // handles every available completion; returns false if there was none
+  bool reap_completions()
+  {
+    unsigned head = *_cq_head;
+    const unsigned tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+
+    if (head == tail)
+    {
+      return false;
+    }
+
+    for (; head != tail; head++)
+    {
+      const io_uring_cqe &cqe = _cqes[head & _cq_mask];
+      const std::size_t s = static_cast<std::size_t>(cqe.user_data);
+      const int res = cqe.res;
+
+      slot_t &slot = _slots[s];
+
+      if (res == -EINTR || res == -EAGAIN)
+      {
+        submit_read(s);
+        continue;
+      }
+
+      if (res == -EINVAL || res == -EOPNOTSUPP)
+      {
+        // the file does not support this kind of read
+        slot.ok = read_rest(slot);
+        slot.status = status_t::done;
+        continue;
+      }
+
+      if (res <= 0)
+      {
+        // error, or the file shrank since `fstat`
+        slot.ok = res == 0;
+        slot.size = slot.offset;
+        slot.status = status_t::done;
+        continue;
+      }
+
+      slot.offset += static_cast<std::size_t>(res);
+
+      if (slot.offset < slot.size)
+      {
+        submit_read(s);
+        continue;
+      }
+
+      slot.ok = true;
+      slot.status = status_t::done;
+    }
+
+    __atomic_store_n(_cq_head, head, __ATOMIC_RELEASE);
+    return true;
+  }
+
+  int _ring_fd = -1;
+
+  void *_sq_ring = nullptr;
+  void *_cq_ring = nullptr;
+  void *_sqes = nullptr;
+  std::size_t _sq_ring_size = 0;
+  std::size_t _cq_ring_size = 0;
+  std::size_t _sqes_size = 0;
+
+  unsigned *_sq_head = nullptr;
+  unsigned *_sq_tail = nullptr;
+  unsigned _sq_mask = 0;
+  unsigned *_sq_array = nullptr;
+
+  unsigned *_cq_head = nullptr;
+  unsigned *_cq_tail = nullptr;
+  unsigned _cq_mask = 0;
+  io_uring_cqe *_cqes = nullptr;
+
+#else
+
+  bool setup_io_uring()
+  {
+    return false;
+  }
+
+  void teardown_io_uring()
+  {
+    // nothing to do here!
+  }
+
+  void wait_for_completions()
+  {
+    // nothing to do here!
+  }
+
+  void submit_read(std::size_t)
+  {
+    // nothing to do here!
+  }
+
+  bool reap_completions()
+  {
+    return false;
+  }
+
+#endif
+
+  const std::vector<const char *> _filenames;
+  std::size_t _next_file = 0;
+
+  std::vector<slot_t> _slots;
+  std::deque<std::size_t> _pending; // slots being loaded, in file order
+
+  std::vector<std::thread> _workers; // empty when io_uring is used
+  std::mutex _mutex;
+  std::condition_variable _jobs_changed;
+  std::condition_variable _job_done;
+  std::deque<std::size_t> _jobs;
+  bool _stopping = false;
+};
+
+}
@@ -0,0 +1,711 @@
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "flexer.hpp"
+#include "flexer_io.hpp"
+
+namespace
+{
+
+int failures = 0;
+
+void check(const bool condition, const std::string &what)
+{
+  if (!condition)
+  {
+    std::cout << "FAILED: " << what << "\n";
+    failures++;
+  }
+}
+
+// kind, index (the diagnostic of an invalid token), offset of the beginning and offset of the end of a token
+using token_entry_t = std::tuple<flexer::token_kind_t, std::size_t, std::size_t, std::size_t>;
+
+token_entry_t make_entry(const flexer::token_kind_t kind, const std::size_t index, const char *begin, const char *end, const char *content)
+{
+  return { kind, index, static_cast<std::size_t>(begin - content), static_cast<std::size_t>(end - content) };
+}
+
+std::vector<token_entry_t> lex_all(flexer::flexer &flexer, const char *content)
+{
+  std::vector<token_entry_t> tokens;
+  flexer::token_t t;
+
+  while (true)
+  {
+    flexer.get_token(t);
+    const std::size_t index = t.get_kind() == flexer::token_kind_t::invalid ? static_cast<std::size_t>(t.get_diagnostic()) : t.get_index();
+    tokens.push_back(make_entry(t.get_kind(), index, t.get_begin(), t.get_end(), content));
+
+    if (t.get_kind() == flexer::token_kind_t::eof || t.get_kind() == flexer::token_kind_t::invalid)
+    {
+      return tokens;
+    }
+  }
+}
+
+class entry_policy_t
+{
+  public:
+
+  static constexpr bool track_lines = false;
+
+  explicit entry_policy_t(const char *content) : _content(content)
+  {
+    // nothing to do here!
+  }
+
+  void on_token(const flexer::token_kind_t kind, const std::size_t index, const char *begin, const char *end)
+  {
+    tokens.push_back(make_entry(kind, index, begin, end, _content));
+  }
+
+  std::vector<token_entry_t> tokens;
+
+  private:
+
+  const char *_content;
+};
+
+// the first token of `input`
+flexer::token_t first_token(const flexer::config_t &config, const char *input)
+{
+  flexer::flexer flexer(config, input);
+  flexer::token_t t;
+  flexer.get_token(t);
+
+  return t;
+}
+
+void test_rule_dfa()
+{
+  flexer::rule_dfa_t dfa;
+  check(flexer::rule_dfa_t::compile({ { "a+", 0 }, { "ab*c", 0 }, { "[0-9]+(\\.[0-9]+)?", 0 } }, dfa), "rules compile");
+
+  std::size_t rule = 0;
+  const std::string input = "aaab abbbc 12.5x 12.x";
+
+  check(dfa.match(input.data(), input.data() + input.size(), rule) == 3 && rule == 0, "longest match of `a+`");
+  check(dfa.match(input.data() + 5, input.data() + input.size(), rule) == 5 && rule == 1, "longest match of `ab*c`");
+  check(dfa.match(input.data() + 11, input.data() + input.size(), rule) == 4 && rule == 2, "optional group taken");
+  check(dfa.match(input.data() + 17, input.data() + input.size(), rule) == 2 && rule == 2, "optional group backed off");
+  check(dfa.match(input.data() + 4, input.data() + input.size(), rule) == 0, "no match on a space");
+
+  flexer::rule_dfa_t ties;
+  check(flexer::rule_dfa_t::compile({ { "[a-z]+", 0 }, { "if", 1 }, { "i[a-z]", 0 } }, ties), "tied rules compile");
+
+  check(ties.match("if", "if" + 2, rule) == 2 && rule == 1, "higher priority wins a tie");
+  check(ties.match("in", "in" + 2, rule) == 2 && rule == 0, "earlier rule wins a tie of the same priority");
+
+  check(!flexer::rule_dfa_t::compile({ { "(a", 0 } }, dfa), "unbalanced group rejected");
+  check(!flexer::rule_dfa_t::compile({ { "[z-a]", 0 } }, dfa), "reversed range rejected");
+  check(!flexer::rule_dfa_t::compile({ { "*a", 0 } }, dfa), "dangling repetition rejected");
+}
+
+void test_rule_arbitration()
+{
+  flexer::config_t config;
+  config.configure_as_c23();
+
+  check(config.add_rule("0x[0-9a-f]+"), "hexadecimal rule added");
+  check(config.add_rule("[a-z]+"), "word rule added");
+  check(config.add_rule("@[a-z]+", 1), "annotation rule added");
+  check(!config.add_rule("[a-"), "malformed rule rejected");
+  check(config.get_rules().size() == 3, "rules kept after a malformed one");
+
+  flexer::token_t t = first_token(config, "0x1f;");
+  check(t.get_kind() == flexer::token_kind_t::rule && t.get_index() == 0 && t.get_end() - t.get_begin() == 4, "longer rule wins over an integer");
+
+  t = first_token(config, "int x");
+  check(t.get_kind() == flexer::token_kind_t::keyword, "built-in wins a tie with a rule of priority 0");
+
+  t = first_token(config, "abc_def");
+  check(t.get_kind() == flexer::token_kind_t::symbol && t.get_end() - t.get_begin() == 7, "longer built-in wins over a rule");
+
+  t = first_token(config, "@inline");
+  check(t.get_kind() == flexer::token_kind_t::rule && t.get_index() == 2, "rule matches where no built-in does");
+
+  flexer::config_t priority;
+  priority.configure_as_c23();
+  check(priority.add_rule("[a-z]+", 1), "priority rule added");
+
+  t = first_token(priority, "int x");
+  check(t.get_kind() == flexer::token_kind_t::rule, "rule of positive priority wins a tie with a built-in");
+}
+
+// offset of the end of the invalid token `input` starts with under `recovery`, with `sync` as the sync set if given
+std::size_t recovery_end(const flexer::recovery_t recovery, const char *sync, const std::string &input)
+{
+  flexer::config_t config;
+  config.configure_as_c23();
+  config.set_recovery(recovery);
+
+  if (sync)
+  {
+    config.set_recovery_sync(sync);
+  }
+
+  flexer::flexer flexer(config, input.c_str());
+  flexer::token_t t;
+  flexer.get_token(t);
+
+  return t.get_kind() == flexer::token_kind_t::invalid ? static_cast<std::size_t>(t.get_end() - input.c_str()) : 0;
+}
+
+// the text of every token of `input` under `recovery`, invalid ones marked with `!`, checking that the padded input
+// lexes alike
+std::vector<std::string> recover_all(const flexer::recovery_t recovery, const char *sync, const std::string &input)
+{
+  flexer::config_t config;
+  config.configure_as_c23();
+  config.set_recovery(recovery);
+
+  if (sync)
+  {
+    config.set_recovery_sync(sync);
+  }
+
+  flexer::padded_buffer_t buffer(input.data(), input.size());
+
+  flexer::flexer plain(config, input.c_str());
+  flexer::flexer padded(config, buffer.data(), buffer.size(), flexer::padded_input);
+
+  std::vector<std::string> texts[2];
+  flexer::flexer *flexers[2] = { &plain, &padded };
+
+  for (std::size_t i = 0; i < 2; i++)
+  {
+    flexer::token_list_t tokens;
+    flexers[i]->tokenize(tokens);
+
+    for (const flexer::token_t &t : tokens)
+    {
+      texts[i].push_back(t.get_kind() == flexer::token_kind_t::eof ? "<eof>" : (t.get_kind() == flexer::token_kind_t::invalid ? "!" : "") + std::string(t.get_begin(), t.get_end()));
+    }
+  }
+
+  check(texts[0] == texts[1], "padded input recovers alike from `" + input + "`");
+  return texts[0];
+}
+
+void test_recovery()
+{
+  // long enough for whole blocks, with the stop past the first one
+  const std::string junk = "@" + std::string(40, '$') + "`x;\n";
+  check(recovery_end(flexer::recovery_t::skip_run, nullptr, junk) == 42, "skip_run stops at the first byte that may start a token");
+
+  const std::string line = "@ " + std::string(40, 'a') + " ;}\nb";
+  check(recovery_end(flexer::recovery_t::skip_to_sync, nullptr, line) == line.find('\n'), "default sync set stops at the newline");
+  check(recovery_end(flexer::recovery_t::skip_to_sync, "", line) == line.find('\n'), "empty sync set stops at the newline");
+  check(recovery_end(flexer::recovery_t::skip_to_sync, "}", line) == line.find('}'), "sync set stops at its own bytes");
+  check(recovery_end(flexer::recovery_t::skip_to_sync, "\x80", line + "\x80") == line.size(), "sync set stops at bytes above 0x7f");
+  check(recovery_end(flexer::recovery_t::skip_to_sync, "#", line) == line.size(), "sync set not found skips to the end");
+
+  // lexing resumes after an unterminated comment or string where each mode says, `skip_run` acting as `skip_line`
+  const std::string body = std::string(30, 'x') + "; more";
+
+  for (const std::string opening : { "/* ", "\"" })
+  {
+    const std::string open = opening + body;
+    const std::string input = "a " + open + "\nb = c;";
+
+    using texts_t = std::vector<std::string>;
+
+    const texts_t rest = { "b", "=", "c", ";", "<eof>" };
+    texts_t line_skipped = { "a", "!" + open };
+    line_skipped.insert(line_skipped.end(), rest.begin(), rest.end());
+
+    texts_t synced = { "a", "!" + opening + std::string(30, 'x'), ";", "more" };
+    synced.insert(synced.end(), rest.begin(), rest.end());
+
+    check(recover_all(flexer::recovery_t::none, nullptr, input) == texts_t{ "a", "!" + input.substr(2) }, "`" + opening + "` without recovery runs to the end");
+    check(recover_all(flexer::recovery_t::skip_run, nullptr, input) == line_skipped, "`" + opening + "` with skip_run resumes on the next line");
+    check(recover_all(flexer::recovery_t::skip_line, nullptr, input) == line_skipped, "`" + opening + "` with skip_line resumes on the next line");
+    check(recover_all(flexer::recovery_t::skip_to_sync, nullptr, input) == line_skipped, "`" + opening + "` with the default sync set resumes on the next line");
+    check(recover_all(flexer::recovery_t::skip_to_sync, ";", input) == synced, "`" + opening + "` with skip_to_sync resumes at the sync byte");
+  }
+}
+
+// a visitor with only the value handlers: the flexer decodes integers and unescapes strings for them alone
+struct value_visitor_t
+{
+  void on_integer(const std::ptrdiff_t value)
+  {
+    integers.push_back(value);
+  }
+
+  void on_string(const std::size_t index, const std::string_view value)
+  {
+    strings.emplace_back(index, value);
+  }
+
+  std::vector<std::ptrdiff_t> integers;
+  std::vector<std::pair<std::size_t, std::string>> strings;
+};
+
+void test_visitor()
+{
+  flexer::config_t config;
+  config.configure_as_c23();
+
+  const char *input = "x = 42 + 0 * y; /* 7 */ s = \"a\\tb\\\"c\"; t = 'q'; u = \"\";";
+
+  flexer::flexer flexer(config, input);
+  value_visitor_t visitor;
+
+  check(flexer.lex(visitor), "visitor lexes the whole input");
+  check(visitor.integers == std::vector<std::ptrdiff_t>{ 42, 0 }, "visitor gets decoded integers");
+  check(visitor.strings == std::vector<std::pair<std::size_t, std::string>>{ { 0, "a\tb\"c" }, { 1, "q" }, { 0, "" } }, "visitor gets unescaped strings with their delimiter");
+}
+
+std::vector<flexer::fingerprint_t> fingerprint(const flexer::config_t &config, const char *input, const flexer::fingerprint_options_t &options)
+{
+  flexer::flexer flexer(config, input);
+  std::pmr::vector<flexer::fingerprint_t> fingerprints;
+  flexer::fingerprint_policy_t policy(input, options, fingerprints);
+  flexer.scan(policy);
+
+  return std::vector<flexer::fingerprint_t>(fingerprints.begin(), fingerprints.end());
+}
+
+std::vector<std::uint64_t> hashes(const std::vector<flexer::fingerprint_t> &fingerprints)
+{
+  std::vector<std::uint64_t> result;
+  for (const flexer::fingerprint_t &fingerprint : fingerprints)
+  {
+    result.push_back(fingerprint.hash);
+  }
+
+  return result;
+}
+
+void test_fingerprints()
+{
+  flexer::config_t config;
+  config.configure_as_c23();
+
+  const char *original = "int add(int a, int b) { return a + b * 2; }\nint main(void) { return add(1, 2); }\n";
+  const char *clone = "int sum(int x, int y) /* renamed */ { return x + y * 3; }\n\n// entry point\nint main(void) { return sum(4, 5); }";
+  const char *other = "while (i < n) { if (p[i] == q) break; i++; }";
+
+  const flexer::fingerprint_options_t options;
+  const std::vector<flexer::fingerprint_t> expected = fingerprint(config, original, options);
+
+  check(!expected.empty(), "fingerprints of a function");
+  check(hashes(fingerprint(config, clone, options)) == hashes(expected), "renamed, re-commented clone shares every fingerprint");
+
+  const std::vector<std::uint64_t> unrelated = hashes(fingerprint(config, other, options));
+  check(std::none_of(unrelated.begin(), unrelated.end(), [&](const std::uint64_t hash) { return std::ranges::count(hashes(expected), hash) > 0; }), "unrelated code shares no fingerprint");
+
+  flexer::fingerprint_options_t exact = options;
+  exact.normalize_symbols = false;
+  check(hashes(fingerprint(config, clone, exact)) != hashes(fingerprint(config, original, exact)), "renamed clone differs when symbols are not normalized");
+
+  check(fingerprint(config, "a + b", options).empty(), "input shorter than the window has no fingerprint");
+  check(fingerprint(config, "a + b - c", options).size() == 1, "input of one window has one fingerprint");
+
+  const flexer::fingerprint_options_t zero = { 0, 0, true, true };
+  const flexer::fingerprint_options_t one = { 1, 1, true, true };
+  const std::vector<flexer::fingerprint_t> clamped = fingerprint(config, original, zero);
+  check(!clamped.empty() && hashes(clamped) == hashes(fingerprint(config, original, one)), "window and winnow of 0 are clamped to 1");
+}
+
+// tokenizes `input`, returning the partner of every token and the unbalanced tokens
+std::pair<std::vector<std::size_t>, std::vector<std::size_t>> match_brackets(const flexer::config_t &config, const char *input)
+{
+  flexer::flexer flexer(config, input);
+  flexer::token_list_t tokens;
+  flexer::bracket_index_t brackets;
+
+  check(flexer.tokenize(tokens, brackets), std::string("tokenizing `") + input + "`");
+
+  std::vector<std::size_t> partners;
+  for (std::size_t i = 0; i < tokens.size(); i++)
+  {
+    partners.push_back(brackets.get_partner(i));
+  }
+
+  return { partners, std::vector<std::size_t>(brackets.get_unbalanced().begin(), brackets.get_unbalanced().end()) };
+}
+
+void test_bracket_index()
+{
+  flexer::config_t config;
+  config.configure_as_c23();
+
+  constexpr std::size_t npos = flexer::bracket_index_t::npos;
+  using partners_t = std::vector<std::size_t>;
+
+  auto [partners, unbalanced] = match_brackets(config, "{ f(a[1]) } x");
+  check(partners == partners_t{ 8, npos, 7, npos, 6, npos, 4, 2, 0, npos, npos } && unbalanced.empty(), "nested pairs matched");
+
+  std::tie(partners, unbalanced) = match_brackets(config, "( ]");
+  check(partners == partners_t{ npos, npos, npos } && unbalanced == partners_t{ 0, 1 }, "`( ]` leaves both unbalanced");
+
+  std::tie(partners, unbalanced) = match_brackets(config, "( [ )");
+  check(partners == partners_t{ 2, npos, 0, npos } && unbalanced == partners_t{ 1 }, "`( [ )` matches the parentheses, not the bracket");
+
+  std::tie(partners, unbalanced) = match_brackets(config, "a }");
+  check(partners == partners_t{ npos, npos, npos } && unbalanced == partners_t{ 1 }, "lone closer unbalanced");
+
+  std::tie(partners, unbalanced) = match_brackets(config, "{ ( ) [");
+  check(partners == partners_t{ npos, 2, 1, npos, npos } && unbalanced == partners_t{ 0, 3 }, "unclosed openers unbalanced");
+}
+
+// a truncated blob is always rejected, a corrupted one is either rejected or still lexes to eof
+void test_blob(const flexer::config_t &config, const std::string &input)
+{
+  std::vector<char> blob;
+  config.serialize(blob);
+
+  flexer::config_t loaded;
+  check(loaded.deserialize(blob.data(), blob.size()), "blob loads");
+
+  std::vector<char> again;
+  loaded.serialize(again);
+  check(again == blob, "blob round trip keeps the lists, the dfa and the tables");
+
+  flexer::flexer original(config, input.c_str());
+  flexer::flexer reloaded(loaded, input.c_str());
+  check(lex_all(original, input.c_str()) == lex_all(reloaded, input.c_str()), "loaded config lexes as the original");
+
+  std::size_t accepted = 0;
+  for (std::size_t size = 0; size < blob.size(); size++)
+  {
+    accepted += loaded.deserialize(blob.data(), size) ? 1 : 0;
+  }
+
+  check(accepted == 0, "truncated blobs rejected");
+
+  // serialize appends, so a blob may be followed by another one: it still loads, but its strings must end in it
+  std::vector<char> followed = blob;
+  config.serialize(followed);
+  check(loaded.deserialize(followed.data(), followed.size()), "blob followed by other data loads");
+
+  followed = blob;
+  followed.back() = 'x'; // the terminator of the last string of the pool
+  followed.push_back('\0');
+  check(!loaded.deserialize(followed.data(), followed.size()), "string ending past the pool rejected");
+
+  for (std::size_t offset = 0; offset < 8; offset += 4)
+  {
+    std::vector<char> corrupted = blob;
+    corrupted[offset] ^= 1;
+
+    check(!loaded.deserialize(corrupted.data(), corrupted.size()), "blob with a corrupted magic or version rejected");
+  }
+
+  const std::string payload = input + " x 0x1f \"s\" /* c */ // d\n";
+  std::size_t rejected = 0;
+
+  for (std::size_t offset = 16; offset + 4 <= blob.size(); offset += 4)
+  {
+    for (const std::uint32_t flip : { 0x00000001u, 0x00000100u, 0x80000000u, 0xffffffffu })
+    {
+      std::vector<char> corrupted = blob;
+      for (std::size_t i = 0; i < 4; i++)
+      {
+        corrupted[offset + i] ^= static_cast<char>(flip >> (8 * i));
+      }
+
+      flexer::config_t candidate;
+      if (!candidate.deserialize(corrupted.data(), corrupted.size()))
+      {
+        rejected++;
+        continue;
+      }
+
+      flexer::flexer flexer(candidate, payload.c_str());
+      flexer::token_t t;
+
+      std::size_t tokens = 0;
+      while (tokens++ <= payload.size())
+      {
+        flexer.get_token(t);
+        if (t.get_kind() == flexer::token_kind_t::eof)
+        {
+          break;
+        }
+      }
+
+      check(tokens <= payload.size() + 1, "corrupted blob at offset " + std::to_string(offset) + " lexes to eof");
+    }
+  }
+
+  check(rejected > 0, "corrupted blobs rejected");
+  check(loaded.get_rules().size() == config.get_rules().size(), "rejected blobs leave the config unchanged");
+}
+
+// a flexer attached to a source manager locates every token, eof included, where a flexer without one does
+void test_source_manager(const flexer::config_t &config, const std::string &input, const std::string &name)
+{
+  const std::string other = "int x;\n\nint y;\n";
+
+  flexer::source_manager_t sources;
+  flexer::file_id_t other_file = 0;
+  flexer::file_id_t file = 0;
+
+  check(sources.add_buffer("other.c", other.data(), other.size(), other_file), name + ": first buffer registered");
+  check(sources.add_buffer("input.c", input.data(), input.size(), file), name + ": second buffer registered");
+
+  flexer::flexer plain(config, input.c_str(), "input.c");
+  flexer::flexer managed(config, sources, file);
+
+  flexer::token_t expected;
+  flexer::token_t t;
+
+  while (true)
+  {
+    plain.get_token(expected);
+    managed.get_token(t);
+
+    const flexer::location_t location = t.get_location(sources);
+
+    check(t.get_kind() == expected.get_kind() && t.get_begin() - input.data() == expected.get_begin() - input.c_str(), name + ": same tokens with a source manager");
+    check(t.get_source_location().is_valid() && !expected.get_source_location().is_valid(), name + ": only tokens of a source manager have a source location");
+    check(location.row() == expected.get_location().row() && location.col() == expected.get_location().col() && std::string(location.filename()) == expected.get_location().filename(),
+      name + ": " + expected.to_string() + " at " + expected.get_location().to_string() + " decodes to " + location.to_string());
+
+    if (expected.get_kind() == flexer::token_kind_t::eof || expected.get_kind() == flexer::token_kind_t::invalid)
+    {
+      break;
+    }
+  }
+}
+
+// the batch reader loads every file, repeated and interleaved with a missing one, as a plain read does; with
+// `use_io_uring` false it runs on the thread pool, which is worth building with -fsanitize=thread
+void test_batch_reader(const std::vector<std::string> &filenames, const std::vector<std::string> &contents, const bool use_io_uring)
+{
+  std::vector<const char *> list;
+  std::vector<const std::string *> expected;
+
+  for (std::size_t round = 0; round < 4; round++)
+  {
+    for (std::size_t i = 0; i < filenames.size(); i++)
+    {
+      list.push_back(filenames[i].c_str());
+      expected.push_back(&contents[i]);
+    }
+
+    list.push_back("/nonexistent/flexer-test");
+    expected.push_back(nullptr);
+  }
+
+  const std::string name = use_io_uring ? "batch reader" : "batch reader on threads";
+
+  flexer::batch_reader_t reader(list, 3, use_io_uring);
+  flexer::loaded_file_t file;
+  std::size_t n = 0;
+
+  while (reader.next(file))
+  {
+    if (n < expected.size())
+    {
+      check(file.ok == (expected[n] != nullptr), name + ": " + file.filename + " loaded or reported");
+      check(!expected[n] || std::string(file.content, file.size) == *expected[n], name + ": " + file.filename + " content");
+      check(file.content[file.size] == '\0', name + ": " + file.filename + " padded");
+    }
+
+    reader.release(file);
+    n++;
+  }
+
+  check(n == list.size(), name + ": every file handed out");
+}
+
+// kind, offsets and location of every token of a list
+std::vector<std::tuple<flexer::token_kind_t, std::size_t, std::size_t, std::size_t, std::size_t>> describe(const flexer::token_list_t &tokens, const char *content, const std::size_t first, const std::size_t last)
+{
+  std::vector<std::tuple<flexer::token_kind_t, std::size_t, std::size_t, std::size_t, std::size_t>> result;
+  for (std::size_t i = first; i < last; i++)
+  {
+    const flexer::token_t &t = tokens[i];
+    result.emplace_back(t.get_kind(), t.get_begin() - content, t.get_end() - content, t.get_location().row(), t.get_location().col());
+  }
+
+  return result;
+}
+
+// lex_range over many windows, with indexes of several intervals extended in no particular order, returns the
+// tokens of a full tokenize that overlap the window, with eof when the window reaches the end of the input
+void test_lex_range(const flexer::config_t &config, const std::string &input, const std::string &name)
+{
+  flexer::flexer full(config, input.c_str());
+  flexer::token_list_t expected;
+
+  if (!full.tokenize(expected) && config.get_recovery() == flexer::recovery_t::none)
+  {
+    return; // lex_range and the index go on past an invalid token, tokenize does not
+  }
+
+  const std::size_t size = input.size();
+
+  std::vector<std::pair<std::size_t, std::size_t>> windows;
+  for (std::size_t begin = 0; begin <= size; begin += size / 29 + 1)
+  {
+    for (const std::size_t length : { std::size_t{ 0 }, std::size_t{ 1 }, std::size_t{ 7 }, std::size_t{ 100 }, size })
+    {
+      windows.emplace_back(begin, std::min(begin + length, size));
+    }
+  }
+
+  windows.emplace_back(size, size);
+  std::reverse(windows.begin() + static_cast<std::ptrdiff_t>(windows.size() / 2), windows.end()); // back and forth
+
+  for (const std::size_t interval : { std::size_t{ 1 }, std::size_t{ 16 }, std::size_t{ 64 * 1024 } })
+  {
+    flexer::flexer flexer(config, input.c_str());
+    flexer::checkpoint_index_t index(interval);
+
+    for (const auto &[begin, end] : windows)
+    {
+      flexer::token_list_t tokens;
+      flexer.lex_range(index, begin, end, tokens);
+
+      std::size_t first = 0;
+      while (first < expected.size() && expected[first].get_kind() != flexer::token_kind_t::eof && static_cast<std::size_t>(expected[first].get_end() - input.c_str()) <= begin)
+      {
+        first++;
+      }
+
+      std::size_t last = first;
+      while (last < expected.size() && (static_cast<std::size_t>(expected[last].get_begin() - input.c_str()) < end || (expected[last].get_kind() == flexer::token_kind_t::eof && end == size)))
+      {
+        last++;
+      }
+
+      check(describe(tokens, input.c_str(), 0, tokens.size()) == describe(expected, input.c_str(), first, last),
+        name + ": lex_range [" + std::to_string(begin) + ", " + std::to_string(end) + ") with interval " + std::to_string(interval));
+    }
+
+    check(flexer.get_location().row() == 1 && flexer.get_location().col() == 1, name + ": lex_range leaves the state of the flexer unchanged");
+  }
+}
+
+// get_token on the plain and the padded input and scan all see the same tokens
+void test_equivalence(const flexer::config_t &config, const std::string &input, const std::string &name)
+{
+  flexer::padded_buffer_t buffer(input.data(), input.size());
+
+  flexer::flexer plain(config, input.c_str());
+  flexer::flexer padded(config, buffer.data(), buffer.size(), flexer::padded_input);
+
+  const std::vector<token_entry_t> expected = lex_all(plain, input.c_str());
+  check(lex_all(padded, buffer.data()) == expected, name + ": padded input lexes as the plain one");
+
+  flexer::flexer scanner(config, input.c_str());
+  entry_policy_t policy(input.c_str());
+  scanner.scan(policy);
+
+  // scan goes on after an invalid token; compare up to where get_token stopped
+  policy.tokens.resize(std::min(policy.tokens.size(), expected.size()));
+  check(policy.tokens == expected, name + ": scan reports the tokens of get_token");
+
+  if (std::get<0>(expected.back()) == flexer::token_kind_t::invalid)
+  {
+    return;
+  }
+
+  flexer::flexer counter(config, buffer.data(), buffer.size(), flexer::padded_input);
+  flexer::count_policy_t count;
+  counter.scan(count);
+
+  for (std::size_t kind = 0; kind < flexer::token_kind_count; kind++)
+  {
+    std::size_t expected_count = 0;
+    for (const token_entry_t &token : expected)
+    {
+      expected_count += static_cast<std::size_t>(std::get<0>(token)) == kind ? 1 : 0;
+    }
+
+    check(count.get_stats().counts[kind] == expected_count, name + ": count policy counts the tokens of get_token");
+  }
+}
+
+}
+
+int main(int argc, const char *argv[])
+{
+  test_rule_dfa();
+  test_rule_arbitration();
+  test_recovery();
+  test_bracket_index();
+  test_visitor();
+  test_fingerprints();
+
+  flexer::config_t config;
+  config.configure_as_c23();
+
+  flexer::config_t with_rules = config;
+  check(with_rules.add_rule("#[a-z]+") && with_rules.add_rule("0x[0-9a-fA-F]+", 1), "rules added to a copy");
+
+  flexer::config_t recovering = config;
+  recovering.set_recovery(flexer::recovery_t::skip_line);
+
+  const std::vector<std::string> inputs =
+  {
+    "",
+    "   \n\t ",
+    "int main(void) { return 0x2a + 'c' + \"s\\\"t\\n\"; }",
+    "a /* multi\nline */ b // trailing",
+    "x = 1; /* unterminated",
+    "s = \"unterminated",
+    "#include <stdio.h>\n#define N 42\n",
+    "x = a\n  // c\n\n/* d */ y\n",
+    "a @ b",
+  };
+
+  for (std::size_t i = 0; i < inputs.size(); i++)
+  {
+    test_equivalence(config, inputs[i], "input " + std::to_string(i));
+    test_equivalence(with_rules, inputs[i], "input " + std::to_string(i) + " with rules");
+    test_source_manager(config, inputs[i], "input " + std::to_string(i));
+    test_lex_range(config, inputs[i], "input " + std::to_string(i));
+    test_lex_range(recovering, inputs[i], "input " + std::to_string(i) + " recovering");
+  }
+
+  test_blob(with_rules, inputs[2]);
+
+  std::vector<std::string> filenames;
+  std::vector<std::string> contents;
+
+  for (int i = 1; i < argc; i++)
+  {
+    std::ifstream file(argv[i]);
+    if (!file.is_open())
+    {
+      check(false, std::string("reading ") + argv[i]);
+      continue;
+    }
+
+    const std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    filenames.push_back(argv[i]);
+    contents.push_back(content);
+
+    test_equivalence(config, content, argv[i]);
+    test_equivalence(with_rules, content, std::string(argv[i]) + " with rules");
+    test_source_manager(config, content, argv[i]);
+    test_lex_range(config, content, argv[i]);
+  }
+
+  test_batch_reader(filenames, contents, false);
+  test_batch_reader(filenames, contents, true);
+
+  if (failures > 0)
+  {
+    std::cout << failures << " check(s) failed\n";
+    return 1;
+  }
+
+  std::cout << "all checks passed\n";
+  return 0;
+}